@@ -0,0 +1,16 @@
+@echo off
+echo Compiling exam system benchmarks...
+gcc -O2 exam_bench.c -o exam_bench.exe -lm -pthread
+if %errorlevel% == 0 (
+    echo.
+    echo Compilation successful!
+    echo.
+    echo Running benchmarks, results go to bench_results.csv
+    echo.
+    exam_bench.exe --csv > bench_results.csv
+    type bench_results.csv
+) else (
+    echo.
+    echo Compilation failed! Please check for errors.
+)
+pause
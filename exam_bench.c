@@ -0,0 +1,356 @@
+// exam_bench.c
+// Microbenchmarks for the exam system data structures.
+// Build: make bench   (or gcc -O2 exam_bench.c -o exam_bench -lm -pthread)
+// Run:   ./exam_bench [--csv] [--max-size N]
+// Every result is one row: benchmark, bank size, iterations timed and
+// nanoseconds per operation. --csv prints the rows as CSV with a fixed
+// header so results can be collected and compared across releases.
+#define EXAM_SYSTEM_NO_MAIN
+#include "exam_system.c"
+
+#include <time.h>
+
+#define BENCH_EXAM_LENGTH 10
+#define BENCH_OPS (1 << 20)   // target operations per per-call benchmark
+
+// Question record as laid out before the hot/cold split (420 bytes)
+typedef struct LegacyQuestion {
+    int id;
+    char question[200];
+    char optionA[50];
+    char optionB[50];
+    char optionC[50];
+    char optionD[50];
+    char correctAnswer;
+    int difficulty;
+    int attempts;
+    int correctCount;
+} LegacyQuestion;
+
+static AskedSet benchAsked;
+static ExamSession benchSession;
+static LegacyQuestion* legacyBank;
+static ExamStats benchStats;
+static int benchCsv = 0;
+static volatile long long benchSink;
+
+static const int benchSizes[] = {10, 100, 1000, 10000, 100000, 1000000};
+
+static long long benchNowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void report(const char* name, int bankSize, long long iterations, long long elapsedNs) {
+    double perOp = iterations > 0 ? (double)elapsedNs / iterations : 0.0;
+    if (benchCsv) {
+        printf("%s,%d,%lld,%.1f\n", name, bankSize, iterations, perOp);
+    } else {
+        printf("%-22s %10d %12lld %14.1f\n", name, bankSize, iterations, perOp);
+    }
+    fflush(stdout);
+}
+
+// Repetitions so a benchmark touching `perRep` items does about BENCH_OPS
+static int repsFor(long long perRep) {
+    long long reps = BENCH_OPS / (perRep > 0 ? perRep : 1);
+    return reps < 1 ? 1 : (int)reps;
+}
+
+static uint32_t nextRandom(uint32_t* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+// Synthetic bank laid out like the sample bank: easy, then medium, then hard
+static void buildSyntheticBank(int n) {
+    char text[64];
+    for (int i = 0; i < n; i++) {
+        int difficulty = 1 + (int)((long long)i * 3 / n);
+        snprintf(text, sizeof(text), "Synthetic question %d", i + 1);
+        addQuestion(i + 1, text, "A", "B", "C", "D", 'A' + i % 4, difficulty);
+    }
+}
+
+static void benchAddQuestion(int n) {
+    int reps = repsFor(n);
+    long long elapsed = 0;
+    for (int r = 0; r < reps; r++) {
+        freeBankIndexes();
+        freeQuestionBank();
+        long long start = benchNowNs();
+        buildSyntheticBank(n);
+        elapsed += benchNowNs() - start;
+    }
+    refreshBankIndexes();
+    freeAskedSet(&benchAsked);
+    initAskedSet(&benchAsked, n);
+    report("add_question", n, (long long)reps * n, elapsed);
+}
+
+static void benchBuildTree(int n) {
+    AdaptiveTree tree = {NULL, 0};
+    int reps = repsFor(n);
+    long long start = benchNowNs();
+    for (int r = 0; r < reps; r++) buildAdaptiveTree(&tree, questionDifficulty, n);
+    report("build_adaptive_tree", n, reps, benchNowNs() - start);
+    freeTree(&tree);
+}
+
+// Rebuilds the tree-mode decision path table for the current bank
+static void benchBuildPathTable(int n) {
+    int reps = n >= 100000 ? 20 : 200;
+    long long start = benchNowNs();
+    for (int r = 0; r < reps; r++) buildPathTable();
+    report("build_path_table", n, reps, benchNowNs() - start);
+}
+
+static void benchQueue(int n) {
+    Queue* q = createQueue();
+    int reps = repsFor(n);
+    long long enqueueNs = 0, dequeueNs = 0;
+    for (int r = 0; r < reps; r++) {
+        long long start = benchNowNs();
+        for (int i = 0; i < n; i++) enqueue(q, &questions[i]);
+        long long middle = benchNowNs();
+        Question* last = NULL;
+        while (!isQueueEmpty(q)) last = dequeue(q);
+        dequeueNs += benchNowNs() - middle;
+        enqueueNs += middle - start;
+        benchSink += last != NULL;
+    }
+    report("enqueue", n, (long long)reps * n, enqueueNs);
+    report("dequeue", n, (long long)reps * n, dequeueNs);
+    freeQueue(q);
+}
+
+static void benchFindStartNode(int n) {
+    long long sum = 0;
+    long long start = benchNowNs();
+    for (int i = 0; i < BENCH_OPS; i++) sum += findStartNode(&adaptiveTree, 1 + i % 3);
+    report("find_start_node", n, BENCH_OPS, benchNowNs() - start);
+    benchSink += sum;
+}
+
+// Picks as an exam makes them: mark each one, start over every exam
+static void benchNextUnasked(int n) {
+    int served = 0;
+    long long start = benchNowNs();
+    for (int i = 0; i < BENCH_OPS; i++) {
+        if (i % BENCH_EXAM_LENGTH == 0) clearAskedSet(&benchAsked);
+        Question* q = getNextUnaskedQuestion(3 - i % 3, &benchAsked);
+        if (q == NULL) q = getAnyUnaskedQuestion(&benchAsked);
+        if (q == NULL) continue;
+        markAsked(&benchAsked, q - questions);
+        served++;
+    }
+    report("get_next_unasked", n, BENCH_OPS, benchNowNs() - start);
+    benchSink += served;
+}
+
+static void benchGetById(int n) {
+    uint32_t state = 2463534242u;
+    long long found = 0;
+    long long start = benchNowNs();
+    for (int i = 0; i < BENCH_OPS; i++) {
+        found += getQuestionById(1 + nextRandom(&state) % (uint32_t)n) != NULL;
+    }
+    report("get_question_by_id", n, BENCH_OPS, benchNowNs() - start);
+    benchSink += found;
+}
+
+static void benchUpdateStats(int n) {
+    memset(&benchStats, 0, sizeof(benchStats));
+    long long start = benchNowNs();
+    for (int i = 0; i < BENCH_OPS; i++) {
+        updateStats(&benchStats, i & 1, 1 + i % 3, 1000);
+    }
+    report("update_stats", n, BENCH_OPS, benchNowNs() - start);
+    benchSink += benchStats.correctAnswers;
+}
+
+// One deadline per session, as the server keeps them: arm n timers spread
+// over an hour, then move each (an answered question) and cancel them all
+static void benchTimerWheel(int n) {
+    static TimerWheel wheel;
+    TimerEntry* timers = (TimerEntry*)calloc((size_t)n, sizeof(TimerEntry));
+    uint32_t state = 12345;
+    initTimerWheel(&wheel, 0);
+    long long start = benchNowNs();
+    for (int i = 0; i < n; i++) {
+        armTimer(&wheel, &timers[i], (uint64_t)(nextRandom(&state) % 3600000) * 1000000ULL);
+    }
+    for (int i = 0; i < n; i++) {
+        armTimer(&wheel, &timers[i], (uint64_t)(nextRandom(&state) % 3600000) * 1000000ULL);
+    }
+    for (int i = 0; i < n; i++) cancelTimer(&wheel, &timers[i]);
+    report("timer_arm_cancel", n, 3LL * n, benchNowNs() - start);
+    benchSink += wheel.count;
+    free(timers);
+}
+
+// A complete non-interactive exam: pick, answer and move through the tree
+// (or the IRT index) until the session ends
+static int sessionExam(ExamMode mode) {
+    int served = 0;
+    if (startSession(&benchSession, BENCH_EXAM_LENGTH, mode) != 0) return 0;
+    while (sessionNextQuestion(&benchSession) != NULL) {
+        submitAnswer(&benchSession, served % 2 ? 'A' : 'B');
+        served++;
+    }
+    return served;
+}
+
+static void benchExam(const char* name, int n, ExamMode mode) {
+    int reps = n >= 100000 ? 200 : 20000;
+    long long served = 0;
+    long long start = benchNowNs();
+    for (int r = 0; r < reps; r++) served += sessionExam(mode);
+    report(name, n, reps, benchNowNs() - start);
+    benchSink += served;
+}
+
+// The linear scans used before the availability index, kept as a baseline
+static Question* legacyNextUnasked(int difficulty, int usedFlags[]) {
+    for (int i = 0; i < questionCount; ++i) {
+        if (!usedFlags[i] && questions[i].difficulty == difficulty) {
+            return &questions[i];
+        }
+    }
+    return NULL;
+}
+
+static Question* legacyAnyUnasked(int usedFlags[]) {
+    for (int i = 0; i < questionCount; ++i) {
+        if (!usedFlags[i]) return &questions[i];
+    }
+    return NULL;
+}
+
+// One exam worth of picks, cycling hard -> medium -> easy
+static int legacyExam(void) {
+    int served = 0;
+    int* usedFlags = (int*)calloc(questionCount, sizeof(int));
+    for (int i = 0; i < BENCH_EXAM_LENGTH; i++) {
+        Question* q = legacyNextUnasked(3 - i % 3, usedFlags);
+        if (q == NULL) q = legacyAnyUnasked(usedFlags);
+        if (q == NULL) break;
+        usedFlags[q - questions] = 1;
+        served++;
+    }
+    free(usedFlags);
+    return served;
+}
+
+static int indexedExam(void) {
+    int served = 0;
+    clearAskedSet(&benchAsked);
+    for (int i = 0; i < BENCH_EXAM_LENGTH; i++) {
+        Question* q = getNextUnaskedQuestion(3 - i % 3, &benchAsked);
+        if (q == NULL) q = getAnyUnaskedQuestion(&benchAsked);
+        if (q == NULL) break;
+        markAsked(&benchAsked, q - questions);
+        served++;
+    }
+    return served;
+}
+
+// Same bank and statistics in the old array-of-structs layout
+static void buildLegacyBank(int n) {
+    free(legacyBank);
+    legacyBank = (LegacyQuestion*)calloc(n, sizeof(LegacyQuestion));
+    for (int i = 0; i < n; i++) {
+        legacyBank[i].id = i + 1;
+        snprintf(legacyBank[i].question, sizeof(legacyBank[i].question), "Synthetic question %d", i + 1);
+        legacyBank[i].difficulty = questionDifficulty[i];
+        legacyBank[i].attempts = i % 7;
+        legacyBank[i].correctCount = i % 3;
+        atomic_store(&questionAttempts[i], i % 7);
+        atomic_store(&questionCorrect[i], i % 3);
+    }
+}
+
+// Per-difficulty attempt/correct totals, as the report screens used to compute them
+static int aggregateLegacyLayout(void) {
+    long long attempted[4] = {0}, correct[4] = {0};
+    for (int i = 0; i < questionCount; i++) {
+        int d = legacyBank[i].difficulty;
+        attempted[d] += legacyBank[i].attempts;
+        correct[d] += legacyBank[i].correctCount;
+    }
+    return (int)(attempted[1] + attempted[2] + attempted[3] + correct[1] + correct[2] + correct[3]);
+}
+
+static int aggregateSplitLayout(void) {
+    long long attempted[4] = {0}, correct[4] = {0};
+    for (int i = 0; i < questionCount; i++) {
+        int d = questionDifficulty[i];
+        attempted[d] += atomic_load_explicit(&questionAttempts[i], memory_order_relaxed);
+        correct[d] += atomic_load_explicit(&questionCorrect[i], memory_order_relaxed);
+    }
+    return (int)(attempted[1] + attempted[2] + attempted[3] + correct[1] + correct[2] + correct[3]);
+}
+
+static void timeReps(const char* name, int n, int (*run)(void), int reps) {
+    long long sum = 0;
+    long long start = benchNowNs();
+    for (int r = 0; r < reps; r++) sum += run();
+    report(name, n, reps, benchNowNs() - start);
+    benchSink += sum;
+}
+
+int main(int argc, char* argv[]) {
+    int maxSize = 1000000;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--csv") == 0) {
+            benchCsv = 1;
+        } else if (strcmp(argv[i], "--max-size") == 0 && i + 1 < argc) {
+            maxSize = atoi(argv[++i]);
+        } else {
+            printf("Usage: %s [--csv] [--max-size N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (benchCsv) {
+        printf("benchmark,bank_size,iterations,ns_per_op\n");
+    } else {
+        printf("%-22s %10s %12s %14s\n", "benchmark", "bank_size", "iterations", "ns_per_op");
+    }
+    for (size_t i = 0; i < sizeof(benchSizes) / sizeof(benchSizes[0]); i++) {
+        int n = benchSizes[i];
+        if (n > maxSize) break;
+        int reps = n >= 100000 ? 20 : 2000;
+
+        benchAddQuestion(n);
+        benchBuildTree(n);
+        benchBuildPathTable(n);
+        benchQueue(n);
+        benchFindStartNode(n);
+        benchNextUnasked(n);
+        benchGetById(n);
+        benchUpdateStats(n);
+        benchTimerWheel(n);
+        benchExam("exam_tree", n, EXAM_MODE_TREE);
+        benchExam("exam_irt", n, EXAM_MODE_IRT);
+
+        // Baselines: linear scans vs the availability index, and the old
+        // 420-byte records vs the split hot-field arrays
+        timeReps("pick_exam_linear", n, legacyExam, reps);
+        timeReps("pick_exam_indexed", n, indexedExam, reps);
+        buildLegacyBank(n);
+        timeReps("difficulty_scan_aos", n, aggregateLegacyLayout, reps);
+        timeReps("difficulty_scan_soa", n, aggregateSplitLayout, reps);
+    }
+
+    free(legacyBank);
+    freeBankIndexes();
+    freeQueue(questionQueue);
+    freeAskedSet(&benchAsked);
+    freeSession(&benchSession);
+    freeQuestionBank();
+    return 0;
+}
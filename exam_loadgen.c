@@ -0,0 +1,223 @@
+// exam_loadgen.c
+// Load generator for the exam server (exam_system --serve PORT).
+// Opens many connections, runs adaptive exams on each with random answers
+// and reports sessions per second and answer-to-next-question latency.
+// Build: gcc -O2 exam_loadgen.c -o exam_loadgen   (Linux only)
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+#define LOADGEN_MAX_EVENTS 256
+#define LOADGEN_LINE_MAX 4096
+
+typedef struct Client {
+    int fd;
+    char in[LOADGEN_LINE_MAX];
+    int inLength;
+    uint64_t answerSentNs;   // 0 when no answer is outstanding
+    unsigned int seed;
+} Client;
+
+typedef struct LoadStats {
+    uint64_t* latencies;
+    size_t latencyCount;
+    size_t latencyCapacity;
+    long sessionsStarted;
+    long sessionsDone;
+    long errors;
+} LoadStats;
+
+static uint64_t nowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void recordLatency(LoadStats* stats, uint64_t ns) {
+    if (stats->latencyCount == stats->latencyCapacity) {
+        stats->latencyCapacity = stats->latencyCapacity ? stats->latencyCapacity * 2 : 4096;
+        stats->latencies = (uint64_t*)realloc(stats->latencies, sizeof(uint64_t) * stats->latencyCapacity);
+    }
+    stats->latencies[stats->latencyCount++] = ns;
+}
+
+static int compareLatency(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+static double percentileUs(const LoadStats* stats, double p) {
+    if (stats->latencyCount == 0) return 0.0;
+    size_t index = (size_t)(p / 100.0 * (double)(stats->latencyCount - 1));
+    return stats->latencies[index] / 1000.0;
+}
+
+static void sendLine(Client* c, const char* line, LoadStats* stats) {
+    size_t length = strlen(line);
+    // Requests are tiny, so a full socket buffer means the server is stuck
+    if (send(c->fd, line, length, MSG_NOSIGNAL) != (ssize_t)length) stats->errors++;
+}
+
+static void startExam(Client* c, int numQuestions, LoadStats* stats) {
+    char line[32];
+    snprintf(line, sizeof(line), "START %d\n", numQuestions);
+    sendLine(c, line, stats);
+    stats->sessionsStarted++;
+}
+
+// Handles one server line; returns 0 when the client is finished
+static int handleLine(Client* c, const char* line, LoadStats* stats,
+                      long sessionTarget, int numQuestions) {
+    if (strncmp(line, "QUESTION", 8) == 0 || strncmp(line, "RESULT", 6) == 0) {
+        if (c->answerSentNs != 0) {
+            recordLatency(stats, nowNs() - c->answerSentNs);
+            c->answerSentNs = 0;
+        }
+    }
+
+    if (strncmp(line, "QUESTION", 8) == 0) {
+        static const char answers[] = "ABCDS";
+        char reply[16];
+        snprintf(reply, sizeof(reply), "ANSWER %c\n", answers[rand_r(&c->seed) % 5]);
+        c->answerSentNs = nowNs();
+        sendLine(c, reply, stats);
+    } else if (strncmp(line, "RESULT", 6) == 0) {
+        stats->sessionsDone++;
+        if (stats->sessionsStarted >= sessionTarget) return 0;
+        startExam(c, numQuestions, stats);
+    } else if (strncmp(line, "ERROR", 5) == 0) {
+        stats->errors++;
+        return 0;
+    }
+    return 1;
+}
+
+static int connectClient(const char* host, int port) {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    if (inet_pton(AF_INET, host, &addr.sin_addr) != 1) return -1;
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    return fd;
+}
+
+int main(int argc, char* argv[]) {
+    const char* host = "127.0.0.1";
+    int port = 9000;
+    int connections = 100;
+    long sessionTarget = 10000;
+    int numQuestions = 10;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--host") == 0 && i + 1 < argc) host = argv[++i];
+        else if (strcmp(argv[i], "--port") == 0 && i + 1 < argc) port = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--connections") == 0 && i + 1 < argc) connections = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--sessions") == 0 && i + 1 < argc) sessionTarget = atol(argv[++i]);
+        else if (strcmp(argv[i], "--questions") == 0 && i + 1 < argc) numQuestions = atoi(argv[++i]);
+        else {
+            printf("Usage: %s [--host ADDR] [--port PORT] [--connections N] [--sessions N] [--questions N]\n",
+                   argv[0]);
+            return 1;
+        }
+    }
+    if (connections < 1) connections = 1;
+    if (sessionTarget < connections) sessionTarget = connections;
+
+    LoadStats stats;
+    memset(&stats, 0, sizeof(stats));
+    Client* clients = (Client*)calloc((size_t)connections, sizeof(Client));
+    int epollFd = epoll_create1(0);
+
+    for (int i = 0; i < connections; i++) {
+        clients[i].fd = connectClient(host, port);
+        if (clients[i].fd < 0) {
+            printf("Cannot connect to %s:%d (%s)\n", host, port, strerror(errno));
+            return 1;
+        }
+        clients[i].seed = (unsigned int)i * 2654435761u + 1;
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.ptr = &clients[i];
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, clients[i].fd, &ev);
+    }
+
+    uint64_t start = nowNs();
+    for (int i = 0; i < connections; i++) startExam(&clients[i], numQuestions, &stats);
+
+    int open = connections;
+    struct epoll_event events[LOADGEN_MAX_EVENTS];
+    while (open > 0) {
+        int count = epoll_wait(epollFd, events, LOADGEN_MAX_EVENTS, 10000);
+        if (count == 0) {
+            printf("Timed out waiting for the server.\n");
+            break;
+        }
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        for (int e = 0; e < count; e++) {
+            Client* c = (Client*)events[e].data.ptr;
+            char buffer[8192];
+            int keep = 1;
+            ssize_t n;
+            while (keep && (n = recv(c->fd, buffer, sizeof(buffer), 0)) > 0) {
+                for (ssize_t i = 0; i < n && keep; i++) {
+                    if (buffer[i] == '\n') {
+                        c->in[c->inLength] = '\0';
+                        c->inLength = 0;
+                        keep = handleLine(c, c->in, &stats, sessionTarget, numQuestions);
+                    } else if (c->inLength < LOADGEN_LINE_MAX - 1) {
+                        c->in[c->inLength++] = buffer[i];
+                    }
+                }
+            }
+            if (keep && n == 0) {
+                stats.errors++;
+                keep = 0;
+            }
+            if (!keep) {
+                epoll_ctl(epollFd, EPOLL_CTL_DEL, c->fd, NULL);
+                close(c->fd);
+                open--;
+            }
+        }
+    }
+    double seconds = (double)(nowNs() - start) / 1e9;
+
+    qsort(stats.latencies, stats.latencyCount, sizeof(uint64_t), compareLatency);
+    printf("connections:        %d\n", connections);
+    printf("sessions completed: %ld in %.2f s\n", stats.sessionsDone, seconds);
+    printf("sessions/sec:       %.0f\n", stats.sessionsDone / seconds);
+    printf("answers:            %zu (%.0f/sec)\n", stats.latencyCount, stats.latencyCount / seconds);
+    printf("latency p50:        %.1f us\n", percentileUs(&stats, 50.0));
+    printf("latency p90:        %.1f us\n", percentileUs(&stats, 90.0));
+    printf("latency p99:        %.1f us\n", percentileUs(&stats, 99.0));
+    printf("latency max:        %.1f us\n", percentileUs(&stats, 100.0));
+    printf("errors:             %ld\n", stats.errors);
+
+    close(epollFd);
+    free(clients);
+    free(stats.latencies);
+    return stats.errors > 0;
+}
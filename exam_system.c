@@ -1,55 +1,316 @@
-// exam_system_adaptive_fixed.c
+// exam_system.c
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <errno.h>
+#include <math.h>
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <io.h>
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#endif
 
-#define MAX_QUESTIONS 50
+#define MAX_EXAM_QUESTIONS 50
 #define NAME_LENGTH 100
 
-// Structure for a question
+// Latency histograms: HIST_SUB_BITS sub-buckets per power of two of ns
+#define HIST_SUB_BITS 3
+#define HIST_BUCKETS ((64 - HIST_SUB_BITS + 1) << HIST_SUB_BITS)
+#define QUESTION_HIST_BUCKETS 48   // one per power of two, up to ~39 hours
+#define SLOWEST_QUESTIONS_SHOWN 5
+#define OUTPUT_BUFFER_SIZE (64 * 1024)  // console output gathered per write
+
+// Item response theory (three-parameter logistic model)
+#define IRT_GRID_POINTS 61           // ability quadrature points on [-4, 4]
+#define IRT_GRID_MIN -4.0
+#define IRT_GRID_STEP (8.0 / (IRT_GRID_POINTS - 1))
+#define IRT_CANDIDATE_WINDOW 8       // unasked items compared on each side of theta
+#define IRT_DEFAULT_GUESSING 0.25f   // four options
+
+// Keyword search
+#define SEARCH_TERM_MAX 32           // longer words are cut to this many bytes
+#define SEARCH_BLOCK_POSTINGS 128    // postings between skip entries
+#define SEARCH_MAX_TERMS 8           // words used from one query
+#define SEARCH_RESULTS_SHOWN 20
+
+// Near-duplicate detection (MinHash signatures bucketed by LSH)
+#define DEDUP_HASHES 32              // MinHash values per question, 16 bits each
+#define DEDUP_BANDS 8                // LSH bands; a band's DEDUP_ROWS values form one 64-bit key
+#define DEDUP_ROWS (DEDUP_HASHES / DEDUP_BANDS)
+#define DEDUP_CHUNK_SLOTS 4096       // bank slots signed per task
+#define DEDUP_BUCKET_COMPARE 8       // earlier bucket members checked per question and band
+#define DEDUP_DEFAULT_SIMILARITY 0.8
+#define DEDUP_CLUSTERS_SHOWN 10
+
+// Decision path table: tree-mode picks for every outcome prefix up to this depth
+#define PATH_TABLE_DEPTH 10
+#define PATH_TABLE_SIZE 29524        // (3^PATH_TABLE_DEPTH - 1) / 2 prefixes
+
+// Batch grading
+#define GRADE_CHUNK_BYTES (1 << 20)  // sheet file slice handed to one task
+#define GRADE_RECORD_BATCH 4096      // history records buffered per worker
+
+// Answer event pipeline
+#define ANSWER_QUEUE_CAPACITY (1 << 16)  // events in flight, power of two
+#define ANSWER_DRAIN_BATCH 256           // events applied per lock hold
+#define ANSWER_IDLE_SPINS 64             // empty polls before the aggregator sleeps
+
+// Form assembly
+#define FORM_DEFAULT_LENGTH 10
+#define FORM_REPAIR_ROUNDS 8         // rebuild passes for forms over the overlap limit
+#define FORM_RANDOM_TRIES 4          // random picks per needed item before sweeping
+
+// Exam history log
+#define HISTORY_MAGIC "EXAMHIST"
+#define HISTORY_VERSION 1
+#define HISTORY_SYNC_BATCH 64       // fsync after this many appended exams
+#define HISTORY_PAGE_SIZE 20        // exams shown per page of history
+#define DEFAULT_HISTORY_PATH "exam_history.log"
+// Response log and item analysis
+#define RESPONSE_MAGIC "EXAMRESP"
+#define RESPONSE_VERSION 1
+#define RESPONSE_SKIPPED 4             // answer code of a skipped or unreadable response
+#define RESPONSE_NO_FORM 0xFFFFFFFFu   // formId of adaptive sessions
+#define DEFAULT_RESPONSE_PATH "exam_responses.log"
+#define GRADE_RESPONSE_BATCH 16384     // responses buffered per grading worker
+#define ITEM_CHUNK_RECORDS (1 << 16)   // response log slice handed to one task
+#define ITEM_MERGE_SLOTS 4096          // bank slots merged per task
+#define ITEM_MIN_RESPONSES 30          // fewer responses are not worth flagging
+#define ITEM_LOW_DISCRIMINATION 0.20   // point-biserial below this needs review
+#define ITEM_REVIEW_SHOWN 10
+// Collusion check
+#define COLLUSION_ENCODE_EXAMS 4096    // exams packed into bit planes per task
+#define COLLUSION_TILE 256             // exams on each side of one comparison task
+#define COLLUSION_DEFAULT_TOP 20       // suspicious pairs reported
+#define COLLUSION_ALPHA_DIGITS 3.0     // flag below 10^-3 after correcting for the pairs compared
+#define COLLUSION_SCREEN_Z 4.0         // standard deviations above chance that earn an exact chance
+#define COLLUSION_PEER_GROUP 50        // fewest candidates behind one wrong-count group
+#define COLLUSION_FIXED_ONE (1 << 10)  // fixed-point scale of the expected matches
+// Exam deadlines (hierarchical timer wheel)
+#define TIMER_WHEEL_BITS 6           // 64 slots per level
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_LEVELS 4         // 2^24 ticks (about 46 hours) before a timer is re-placed
+#define TIMER_TICK_NS 10000000ULL    // 10 ms wheel resolution
+// Engine snapshots
+#define SNAPSHOT_MAGIC "EXAMSNAP"
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_ALIGN 64             // every section starts on a cache line
+#define SNAPSHOT_INTERVAL_SECONDS 60  // minimum gap between periodic snapshots
+
+#ifdef _WIN32
+#define HISTORY_OPEN_FLAGS (O_RDWR | O_CREAT | O_APPEND | O_BINARY)
+#define SNAPSHOT_OPEN_FLAGS (O_WRONLY | O_CREAT | O_TRUNC | O_BINARY)
+#define fsync _commit
+#define ftruncate _chsize
+typedef long ssize_t;
+#else
+#define HISTORY_OPEN_FLAGS (O_RDWR | O_CREAT | O_APPEND)
+#define SNAPSHOT_OPEN_FLAGS (O_WRONLY | O_CREAT | O_TRUNC)
+#endif
+
+// View into the question bank text arena (no terminator, use %.*s)
+typedef struct TextRef {
+    uint32_t offset;
+    uint32_t length;
+} TextRef;
+
+// Pre-rendered forms of each question (see renderQuestions)
+typedef enum RenderKind {
+    RENDER_CONSOLE,   // the block displayQuestion() prints
+    RENDER_PROTOCOL   // the server's QUESTION line
+} RenderKind;
+
+// Console output gathered into large writes
+typedef struct OutputBuffer {
+    char data[OUTPUT_BUFFER_SIZE];
+    size_t length;
+} OutputBuffer;
+
+// Answer-time histogram with HIST_SUB_BITS precision (about 12%)
+typedef struct LatencyHistogram {
+    uint64_t count;
+    uint64_t totalNs;
+    uint64_t maxNs;
+    uint32_t buckets[HIST_BUCKETS];
+} LatencyHistogram;
+
+// Coarse power-of-two answer-time histogram kept per question
+typedef struct QuestionLatency {
+    uint32_t count;
+    uint64_t totalNs;
+    uint32_t buckets[QUESTION_HIST_BUCKETS];
+} QuestionLatency;
+
+// Structure for a question. Only the cold, per-question details live here;
+// the fields that scans read (difficulty, attempts, correct count) are kept
+// in parallel arrays indexed by bank slot, see questionDifficulty. A
+// Question never changes once added, so embedded banks keep them read-only.
 typedef struct Question {
-    int id;
-    char question[200];
-    char optionA[50];
-    char optionB[50];
-    char optionC[50];
-    char optionD[50];
+    long long id;   // any 64-bit id; unique within the bank
+    TextRef question;
+    TextRef optionA;
+    TextRef optionB;
+    TextRef optionC;
+    TextRef optionD;
     char correctAnswer;
-    int difficulty; // 1 = Easy, 2 = Medium, 3 = Hard
-    int attempts;
-    int correctCount;
+    int difficulty; // 1 = Easy, 2 = Medium, 3 = Hard (also in questionDifficulty)
+    float irtA;     // 3PL discrimination
+    float irtB;     // 3PL difficulty, on the ability scale
+    float irtC;     // 3PL guessing floor
 } Question;
 
-// Queue Node for managing question flow
-typedef struct QueueNode {
-    Question* question;
-    struct QueueNode* next;
-} QueueNode;
+// Running totals behind the report screens, kept up to date as questions,
+// answers and exams come in so the screens never rescan the bank or the
+// history. Updates are relaxed atomic adds, so concurrent sessions can bump
+// them without a lock.
+typedef struct BankAggregates {
+    atomic_long questionCount[4];  // per difficulty (1..3)
+    atomic_long attempts[4];
+    atomic_long correct[4];
+    atomic_llong examCount;        // records in the history log
+    atomic_llong scoreSumMilli;    // sum of exam scores, in 1/1000 of a percent
+} BankAggregates;
 
-// Queue structure
+// Questions with the slowest median answer time, maintained on every answer.
+// Answers only ever move a question up, except when a question on the board
+// gets faster: a question pushed off earlier may then belong back on it, so
+// the board is marked stale and re-ranked from the histograms when read.
+typedef struct SlowQuestionBoard {
+    atomic_flag lock;
+    int count;
+    int slots[SLOWEST_QUESTIONS_SHOWN];
+    uint64_t medianNs[SLOWEST_QUESTIONS_SHOWN];
+    uint64_t meanNs[SLOWEST_QUESTIONS_SHOWN];
+    int stale;       // a question on the board got faster since the last ranking
+} SlowQuestionBoard;
+
+// Slot of the id index: open addressing with linear probing over one flat
+// array, so a lookup is a hash and (almost always) a single cache line
+typedef struct QuestionIdEntry {
+    long long id;
+    int slot;       // bank slot, -1 when the entry is empty
+} QuestionIdEntry;
+
+// Queue structure: growable ring buffer, so enqueue/dequeue never allocate
+// except when the buffer doubles
 typedef struct Queue {
-    QueueNode* front;
-    QueueNode* rear;
+    Question** items;
+    int capacity;  // power of two
+    int head;
     int count;
 } Queue;
 
-// Binary Tree Node for adaptive selection
-typedef struct TreeNode {
-    Question* question;
-    struct TreeNode* left;   // Difficulty increases (harder)
-    struct TreeNode* right;  // Difficulty decreases (easier)
-} TreeNode;
+// Binary Tree for adaptive selection, stored as an implicit (Eytzinger)
+// array: node i has its left child at 2i+1 and its right child at 2i+2.
+// In-order the nodes run from hardest to easiest, so the left subtree is
+// harder (or equal) and the right subtree is easier (or equal).
+typedef struct AdaptiveTree {
+    int* slots;  // bank slot of the question at each node
+    int size;
+} AdaptiveTree;
+
+// Entry of the IRT item index, sorted by the ability at which each item is
+// most informative
+typedef struct IrtEntry {
+    float peak;
+    int slot;
+} IrtEntry;
+
+// One word of the search index. Its postings are the bank slots whose text
+// contains it, delta-encoded as varints in blocks of SEARCH_BLOCK_POSTINGS
+// (the first slot of each block is kept in its skip entry instead).
+typedef struct SearchTerm {
+    uint32_t textOffset;     // in searchIndex.termText
+    uint16_t length;
+    uint32_t postingCount;
+    uint32_t skipOffset;     // first entry in searchIndex.skips
+    size_t postingOffset;    // in searchIndex.postings
+} SearchTerm;
+
+typedef struct SearchSkip {
+    int firstSlot;
+    uint32_t byteOffset;     // from the term's postingOffset
+} SearchSkip;
+
+typedef struct SearchIndex {
+    SearchTerm* terms;
+    int termCount;
+    int termCapacity;
+    uint64_t* table;         // open addressing: hash tag << 32 | term index + 1, 0 when empty
+    size_t tableCapacity;    // power of two
+    char* termText;
+    size_t termTextSize;
+    size_t termTextCapacity;
+    unsigned char* postings;
+    size_t postingSize;
+    SearchSkip* skips;
+    size_t skipCount;
+    unsigned long version;   // bankVersion the index was built for
+} SearchIndex;
+
+// Bank and indexes compiled into the binary (see emitEmbeddedBank)
+typedef struct EmbeddedBank {
+    const char* text;
+    size_t textSize;
+    const Question* questions;
+    int questionCount;
+    const unsigned char* difficulty;
+    atomic_int* attempts;
+    atomic_int* correct;
+    const int* difficultySlots[4];
+    int difficultySlotCount[4];
+    const int* treeSlots;
+    const IrtEntry* irtIndex;
+    const QuestionIdEntry* idIndex;
+    int idCapacity;
+} EmbeddedBank;
 
 // Performance tracking structure
 typedef struct Performance {
-    int questionId;
+    long long questionId;
     char userAnswer;
     char correctAnswer;
     int isCorrect;
-    float timeSpent;
+    uint64_t timeSpentNs;  // from showing the question to the answer
 } Performance;
 
+// Per-exam record of asked questions. Cursors point at the first position
+// in each difficulty list (and in the bank) that may still be unasked; they
+// only move forward, so each pick is amortized O(1). The set remembers which
+// slots it marked, so clearing it for the next exam costs O(exam length).
+typedef struct AskedSet {
+    uint64_t* bits;          // one bit per bank slot
+    int wordCount;
+    int difficultyCursor[4]; // position in difficultySlots[d]
+    int anyCursor;           // bank slot
+    int* marked;             // slots marked since the last clear
+    int markedCount;
+    int markedCapacity;
+} AskedSet;
+
 // Exam Statistics
 typedef struct ExamStats {
     int totalQuestions;
@@ -57,53 +318,627 @@ typedef struct ExamStats {
     int wrongAnswers;
     int skippedQuestions;
     float averageDifficulty;
-    float timeTaken;
+    uint64_t timeTakenNs;
 } ExamStats;
 
+// Header at the start of the exam history log
+typedef struct HistoryHeader {
+    char magic[8];        // HISTORY_MAGIC, no terminator
+    uint32_t version;
+    uint32_t recordSize;  // sizeof(ExamRecord)
+} HistoryHeader;
+
+// One finished exam in the history log (fixed size, host byte order)
+typedef struct ExamRecord {
+    uint64_t finishedAt;  // seconds since the epoch
+    uint64_t timeTakenNs;
+    int32_t totalQuestions;
+    int32_t correctAnswers;
+    int32_t wrongAnswers;
+    int32_t skippedQuestions;
+    float averageDifficulty;
+    uint32_t reserved;
+} ExamRecord;
+
+// One answered or skipped question in the response log (fixed size, host
+// byte order). An exam's responses are appended together in the order they
+// were asked, and each carries the exam's score, so any slice of the log can
+// be analysed without looking elsewhere. The log starts with a HistoryHeader
+// holding RESPONSE_MAGIC.
+typedef struct ResponseRecord {
+    int64_t questionId;
+    uint32_t formId;       // paper form of a graded sheet, RESPONSE_NO_FORM for sessions
+    uint32_t timeMs;       // answer time, 0 when unknown
+    uint16_t examCorrect;  // correct answers in the whole exam
+    uint16_t examLength;   // responses in the exam
+    uint8_t position;      // order of the response within its exam
+    uint8_t answer;        // 0-3 for A-D, RESPONSE_SKIPPED
+    uint8_t isCorrect;
+    uint8_t reserved;
+} ResponseRecord;
+
+// Sections of an engine snapshot, in file order
+typedef enum SnapshotSectionId {
+    SNAPSHOT_TEXT,          // question text arena
+    SNAPSHOT_QUESTIONS,     // Question[questionCount]
+    SNAPSHOT_DIFFICULTY,    // questionDifficulty
+    SNAPSHOT_ATTEMPTS,      // questionAttempts
+    SNAPSHOT_CORRECT,       // questionCorrect
+    SNAPSHOT_EASY_SLOTS,    // difficultySlots[1..3]
+    SNAPSHOT_MEDIUM_SLOTS,
+    SNAPSHOT_HARD_SLOTS,
+    SNAPSHOT_TREE,          // adaptiveTree.slots
+    SNAPSHOT_IRT_INDEX,     // irtIndex
+    SNAPSHOT_ID_INDEX,      // questionIdIndex
+    SNAPSHOT_LATENCY,       // SnapshotLatency for every answered question
+    SNAPSHOT_SECTIONS
+} SnapshotSectionId;
+
+typedef struct SnapshotSection {
+    uint64_t offset;  // from the start of the file, a multiple of SNAPSHOT_ALIGN
+    uint64_t size;
+} SnapshotSection;
+
+// Answer-time histogram of one question in a snapshot
+typedef struct SnapshotLatency {
+    int32_t slot;
+    uint32_t reserved;
+    QuestionLatency latency;
+} SnapshotLatency;
+
+// Header at the start of an engine snapshot (host byte order). The tables
+// follow as they are laid out in memory, so a restore maps the file and
+// points the globals into it.
+typedef struct SnapshotHeader {
+    char magic[8];             // SNAPSHOT_MAGIC, no terminator
+    uint64_t checksum;         // snapshotChecksum() of every byte after this field
+    uint32_t version;
+    uint32_t headerSize;       // sizeof(SnapshotHeader)
+    uint32_t questionSize;     // sizeof(Question)
+    int32_t questionCount;
+    int32_t idCapacity;
+    int32_t slowCount;
+    uint64_t fileSize;
+    uint64_t bankFingerprint;  // see bankFingerprint()
+    uint64_t savedAt;          // seconds since the epoch
+    int64_t examRecords;       // history records included in the exam totals
+    int64_t scoreSumMilli;
+    int64_t attempts[4];       // per difficulty (1..3)
+    int64_t correct[4];
+    int32_t slowSlots[SLOWEST_QUESTIONS_SHOWN];
+    uint32_t reserved;
+    uint64_t slowMedianNs[SLOWEST_QUESTIONS_SHOWN];
+    uint64_t slowMeanNs[SLOWEST_QUESTIONS_SHOWN];
+    LatencyHistogram difficultyLatency[4];
+    SnapshotSection sections[SNAPSHOT_SECTIONS];
+} SnapshotHeader;
+
+// A snapshot about to be written: the finished header and where each
+// section's bytes are taken from
+typedef struct SnapshotPlan {
+    SnapshotHeader header;
+    const void* source[SNAPSHOT_SECTIONS];
+} SnapshotPlan;
+
+// How a session picks its next question
+typedef enum ExamMode {
+    EXAM_MODE_TREE,  // walk the adaptive difficulty tree
+    EXAM_MODE_IRT    // most informative item at the current ability estimate
+} ExamMode;
+
+// Answer key of one paper form. Answers are packed into two bit planes
+// (A=00, B=01, C=10, D=11; bit i is item i), so a whole sheet is scored
+// with one XOR/AND and a popcount.
+typedef struct AnswerForm {
+    int id;
+    int length;
+    int slots[MAX_EXAM_QUESTIONS];  // bank slot of each item
+    uint64_t keyLow;
+    uint64_t keyHigh;
+    uint64_t mask;                  // one bit per item
+    float averageDifficulty;
+    int line;                       // line of the sheet file defining it
+} AnswerForm;
+
+// Per-thread results of a grading run, merged once all sheets are done
+typedef struct GradeWorker {
+    long long* attempts;   // [form * MAX_EXAM_QUESTIONS + position]
+    long long* correct;
+    long long graded;
+    long long rejected;
+    long long itemsGraded;
+    ExamRecord* records;   // awaiting a batched append to the history
+    int recordCount;
+    ResponseRecord* responses;  // awaiting a batched append to the response log
+    int responseCount;
+} GradeWorker;
+
+typedef struct GradeJob {
+    const char* data;
+    size_t size;
+    size_t bodyStart;      // first byte after the FORM lines
+    AnswerForm* forms;     // sorted by id
+    int formCount;
+    GradeWorker* workers;
+    uint64_t finishedAt;
+} GradeJob;
+
+// Per-thread sums of an item analysis run, one entry per bank slot. Scores
+// are rest scores (the exam score without the item itself), so an item is
+// not correlated with its own answer.
+typedef struct ItemWorker {
+    long long* responses;
+    long long* correct;
+    long long* restSum;
+    long long* restSquares;
+    long long* correctRestSum;  // rest score summed over correct responses
+    long long* options;         // [answer * slotCount + slot], A-D then skipped
+    long long unmatched;        // responses to questions not in the bank
+    long long exams;            // responses opening an exam
+} ItemWorker;
+
+// Merged statistics of one bank slot
+typedef struct ItemStatistics {
+    long long responses;
+    double pValue;              // share of responses answered correctly
+    double discrimination;      // point-biserial with the rest score
+    double optionShare[5];      // A-D then skipped
+} ItemStatistics;
+
+typedef struct ItemAnalysisJob {
+    const ResponseRecord* records;
+    long long recordCount;
+    int slotCount;
+    ItemWorker* workers;
+    int workerCount;
+    ItemStatistics* items;      // by bank slot
+} ItemAnalysisJob;
+
+// Near-duplicate check over the bank. Each band task finds, for every
+// question, an earlier question sharing that band's key and a similar
+// enough signature, and records the pair as an edge.
+typedef struct DedupJob {
+    uint16_t* signatures;          // DEDUP_HASHES values per bank slot
+    unsigned char* hasText;        // by slot: 0 when no words were found
+    uint32_t hashA[DEDUP_HASHES];  // multiply-shift hash of each signature value
+    uint32_t hashB[DEDUP_HASHES];
+    int matchesNeeded;             // equal values that make a near-duplicate
+    int slotCount;
+    int* tables;                   // per worker: bucket heads, tableSize entries
+    int* chains;                   // per worker: previous slot in the bucket
+    size_t tableSize;              // power of two, at least twice the slots
+    int tableShift;                // 64 - log2(tableSize)
+    int* edges[DEDUP_BANDS];       // slot pairs found by each band
+    size_t edgeCounts[DEDUP_BANDS];
+    int bandFailed[DEDUP_BANDS];   // a band ran out of memory
+} DedupJob;
+
+// One exam taken on a paper form, found in the response log
+typedef struct CollusionExam {
+    long long firstRecord;
+    uint32_t formId;
+    int length;
+    int number;             // 1-based position among all exams in the log
+    int block;
+} CollusionExam;
+
+// The exams of one form, contiguous in the job's arrays. chance holds, for
+// each number of wrong answers w, item i and option o, the share of the
+// form's candidates with about w wrong answers who chose o on item i, at
+// index (w * MAX_EXAM_QUESTIONS + i) * 4 + o.
+typedef struct CollusionBlock {
+    int first;
+    int count;
+    int length;
+    float* chance;
+} CollusionBlock;
+
+// Two square tiles of one block to compare (the same tile on the diagonal)
+typedef struct CollusionTask {
+    int block;
+    int rowTile;
+    int columnTile;
+} CollusionTask;
+
+typedef struct CollusionPair {
+    int a, b;               // exams, in the job's order
+    int source;             // a or b: the exam whose wrong answers were matched
+    float surprise;         // -log10 of the chance of so many matches
+} CollusionPair;
+
+// Per-thread results: the most suspicious pairs seen, as a min-heap
+typedef struct CollusionWorker {
+    CollusionPair* top;
+    int topCount;
+    long long compared;
+    long long flagged;
+} CollusionWorker;
+
+// Answers of every exam packed like a graded sheet (bit i is item i):
+// two planes for the option (A=00, B=01, C=10, D=11), the items answered
+// and the items answered wrong. expected[e * (MAX_EXAM_QUESTIONS + 1) + w]
+// is how many of exam e's wrong answers a candidate with w wrong answers
+// would match by chance (upper 16 bits) and its variance (lower 16 bits),
+// in fixed point.
+typedef struct CollusionJob {
+    const ResponseRecord* records;
+    CollusionExam* exams;   // sorted by form
+    int examCount;
+    uint64_t* low;
+    uint64_t* high;
+    uint64_t* answered;
+    uint64_t* wrong;
+    unsigned char* wrongCount;
+    uint32_t* expected;
+    CollusionBlock* blocks;
+    int blockCount;
+    CollusionTask* tasks;
+    int taskCount;
+    CollusionWorker* workers;
+    int topLimit;
+    float flagSurprise;     // surprise at which a pair counts as flagged
+} CollusionJob;
+
+// One assembled paper form
+typedef struct PaperForm {
+    int slots[MAX_EXAM_QUESTIONS];  // bank slots, by difficulty
+    int length;
+    int counts[4];                  // items per difficulty (1..3)
+    int maxOverlap;                 // most items shared with any other form
+} PaperForm;
+
+// Per-thread scratch of the overlap pass
+typedef struct AssemblyWorker {
+    int* overlap;          // items shared with each form, by form
+    int* touched;          // forms with a non-zero entry in overlap
+    long long pairsOverLimit;
+    int maxOverlap;
+} AssemblyWorker;
+
+typedef struct AssemblyJob {
+    int formCount;
+    int formLength;
+    int maxOverlap;        // most items two forms may share
+    int target[4];         // blueprint: items per difficulty (1..3)
+    int exposureCap[4];    // most forms one item of each difficulty may appear on
+    int round;             // 0 builds every form, later rounds only those in redo
+    PaperForm* forms;
+    atomic_int* exposure;  // forms using each bank slot
+    atomic_int* redo;      // forms to rebuild in the next round
+    int* itemStart;        // item -> forms index: formsOfItem[itemStart[s] .. itemStart[s + 1])
+    int* formsOfItem;
+    AssemblyWorker* workers;
+} AssemblyJob;
+
+// Work handed to the threads of one parallelFor() call
+typedef void (*TaskFunction)(void* context, int worker, int task);
+
+typedef struct ParallelRun {
+    TaskFunction function;
+    void* context;
+    int taskCount;
+    atomic_int nextTask;
+} ParallelRun;
+
+typedef struct ParallelWorker {
+    ParallelRun* run;
+    int index;
+} ParallelWorker;
+
+// One graded answer on its way to the statistics
+typedef struct AnswerEvent {
+    int slot;       // bank slot of the question
+    int isCorrect;
+    uint64_t timeNs;
+} AnswerEvent;
+
+typedef struct AnswerCell {
+    atomic_size_t sequence;  // == position + 1 once the event is written
+    AnswerEvent event;
+} AnswerCell;
+
+// Bounded multi-producer, single-consumer ring of answer events
+typedef struct AnswerQueue {
+    AnswerCell* cells;
+    size_t mask;
+    char padding0[64];
+    atomic_size_t enqueuePos;   // next position producers claim
+    char padding1[64];
+    size_t dequeuePos;          // next position the aggregator reads
+    atomic_size_t appliedPos;   // every event before this has been applied
+    atomic_flag applyLock;      // held while events are applied
+    atomic_int running;
+    atomic_int stopping;
+    atomic_int sleeping;        // aggregator is parked on `wake`
+#ifdef _WIN32
+    HANDLE thread;
+    CRITICAL_SECTION wakeLock;
+    CONDITION_VARIABLE wake;
+#else
+    pthread_t thread;
+    pthread_mutex_t wakeLock;
+    pthread_cond_t wake;
+#endif
+} AnswerQueue;
+
+// Timer linked into a TimerWheel slot; `owner` is free for the caller
+typedef struct TimerEntry {
+    struct TimerEntry* next;    // NULL while the timer is not armed
+    struct TimerEntry* prev;
+    uint64_t expires;           // wheel tick the timer fires on
+    int slot;                   // level * TIMER_WHEEL_SLOTS + slot it is linked into
+    void* owner;
+} TimerEntry;
+
+typedef void (*TimerCallback)(void* context, TimerEntry* timer);
+
+// Hierarchical timer wheel: level L holds timers due within 64^(L+1) ticks
+// in slots of 64^L ticks, and a slot is re-placed one level down when the
+// wheel reaches it. Arming and cancelling only link or unlink one entry.
+typedef struct TimerWheel {
+    TimerEntry heads[TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS];  // list sentinels
+    uint64_t occupied[TIMER_WHEEL_LEVELS];  // non-empty slots of each level
+    uint64_t now;                           // last tick processed
+    uint64_t originNs;                      // monotonic time of tick 0
+    int count;                              // timers armed
+} TimerWheel;
+
+// One candidate's exam in progress. Sessions only read the shared bank and
+// its indexes; everything that changes during an exam lives here, so any
+// number of sessions can run side by side.
+typedef struct ExamSession {
+    ExamStats stats;
+    Performance performances[MAX_EXAM_QUESTIONS];
+    int performanceCount;
+    ResponseRecord responses[MAX_EXAM_QUESTIONS];  // every question asked, for the response log
+    int responseCount;
+    AskedSet asked;
+    int numQuestions;
+    int askedCount;
+    int currentNode;            // adaptive tree node to serve next, -1 if none
+    int pathNode;               // outcome prefix in the path table, -1 once off it
+    Question* pending;          // question served and awaiting an answer
+    uint64_t shownAtNs;         // when pending was served
+    uint64_t examDeadlineNs;    // exam ends at this monotonic time, 0 for no limit
+    uint64_t questionDeadlineNs;  // pending is skipped at this time, 0 for no limit
+    int timeouts;               // questions skipped because their time ran out
+    unsigned long bankVersion;  // bank the session was started against
+    ExamMode mode;
+    double theta;               // IRT ability estimate (posterior mean)
+    double thetaSE;             // and its standard error
+    double abilityLogPosterior[IRT_GRID_POINTS];
+} ExamSession;
+
+// Outcome of submitting an answer to a session
+typedef enum AnswerResult {
+    ANSWER_CORRECT,
+    ANSWER_WRONG,
+    ANSWER_SKIPPED,
+    ANSWER_NO_QUESTION,
+    ANSWER_TIMED_OUT            // answered (or expired) after the question's deadline
+} AnswerResult;
+
 // Global variables
-Question questions[MAX_QUESTIONS];
-Queue* questionQueue;
-TreeNode* adaptiveTree;
-Performance performances[MAX_QUESTIONS];
-ExamStats currentStats;
+Question* questions = NULL;
+int questionCapacity = 0;
+unsigned char* questionDifficulty = NULL;  // hot fields by bank slot (structure of arrays)
+atomic_int* questionAttempts = NULL;
+atomic_int* questionCorrect = NULL;
+QuestionLatency** questionLatency = NULL; // allocated on a question's first answer
+int bankBorrowed = 0;          // bank tables are compiled in or snapshot-mapped, not owned
+int indexesBorrowed = 0;       // index tables are compiled in or snapshot-mapped, not owned
+char* snapshotMapping = NULL;  // restored snapshot backing the borrowed tables
+size_t snapshotSize = 0;
+long long snapshotExamRecords = -1;  // history records counted in the restored snapshot
+QuestionIdEntry* questionIdIndex = NULL;  // id -> bank slot, at most half full
+int questionIdCapacity = 0;                // power of two
+char* bankText = NULL;         // text arena: a mapped bank file or a heap buffer
+size_t bankTextSize = 0;
+size_t bankTextCapacity = 0;   // 0 while bankText is a read-only file mapping
+unsigned long bankVersion = 1; // bumped on every change to the bank
+unsigned long indexedBankVersion = 0;
+char* renderedText = NULL;     // pre-rendered question blocks
+size_t* renderedOffset = NULL; // block k of slot i spans [2i+k, 2i+k+1)
+unsigned long renderedVersion = 0;  // bankVersion the blocks were built for
+int* difficultySlots[4];       // bank slots of each difficulty (1..3), in bank order
+int difficultySlotCount[4];
+IrtEntry* irtIndex = NULL;     // all bank slots, sorted by information peak
+int irtIndexSize = 0;
+SearchIndex searchIndex;       // inverted index over question and option text
+int* pathTable = NULL;         // tree-mode pick per outcome prefix, -1 when the bank runs out
+int pathStartNode = -1;        // tree node every tree-mode exam starts from
+unsigned long pathTableVersion = 0;  // bankVersion the table was built for
+Queue* questionQueue;          // in-order view of the adaptive tree
+AdaptiveTree adaptiveTree;
+ExamSession consoleSession;    // session used by the interactive front-end
+uint64_t examTimeLimitNs = 0;      // per exam, 0 for no limit
+uint64_t questionTimeLimitNs = 0;  // per question, 0 for no limit
+uint64_t idleTimeoutNs = 0;        // server connections silent this long are closed, 0 never
+LatencyHistogram difficultyLatency[4];  // answer times per difficulty (1..3)
 int questionCount = 0;
-int performanceCount = 0;
-int totalExamsTaken = 0;
-ExamStats allExams[10];
+BankAggregates aggregates;
+SlowQuestionBoard slowQuestions = {ATOMIC_FLAG_INIT, 0, {0}, {0}, {0}, 0};
+int historyFd = -1;
+const char* historyPath = NULL;
+int historyUnsynced = 0;       // appends since the last fsync
+atomic_flag historyLock = ATOMIC_FLAG_INIT;  // serializes appends from worker threads
+int responseFd = -1;
+const char* responsePath = NULL;
+int responseUnsynced = 0;
+atomic_flag responseLock = ATOMIC_FLAG_INIT;
+AnswerQueue answerQueue = {.applyLock = ATOMIC_FLAG_INIT};
+const char* snapshotPath = NULL;   // written periodically and on exit when set
+uint64_t snapshotFingerprint = 0;  // bankFingerprint() of the bank in use
+time_t snapshotWrittenAt = 0;
+long long snapshotExams = -1;      // exams counted when the last periodic snapshot started
+#ifndef _WIN32
+pid_t snapshotWriter = 0;          // forked child writing a periodic snapshot, 0 if none
+#endif
+
+// Bank tables generated by --emit-bank, compiled in with -DEMBEDDED_BANK
+#ifdef EMBEDDED_BANK
+#include EMBEDDED_BANK
+#endif
 
 // Function prototypes
 // Queue operations
 Queue* createQueue();
-void enqueue(Queue* q, Question* question);
+int enqueue(Queue* q, Question* question);
 Question* dequeue(Queue* q);
 int isQueueEmpty(Queue* q);
+void clearQueue(Queue* q);
+void freeQueue(Queue* q);
 void flushInput(void);
 
 // Binary Tree operations
-TreeNode* createTreeNode(Question* question);
-void buildAdaptiveTree(TreeNode** root, Question* questions, int n);
-TreeNode* insertQuestion(TreeNode* root, Question* question);
-void traverseTree(TreeNode* root, Queue* q); // implemented
-void freeTree(TreeNode* root);
+void buildAdaptiveTree(AdaptiveTree* tree, const unsigned char* difficulty, int n);
+int treeLeft(const AdaptiveTree* tree, int node);
+int treeRight(const AdaptiveTree* tree, int node);
+Question* treeQuestion(const AdaptiveTree* tree, int node);
+int traverseTree(const AdaptiveTree* tree, Queue* q);
+void freeTree(AdaptiveTree* tree);
 
 // Question operations
-void addQuestion(int id, char* q, char* a, char* b, char* c, char* d,
+void addQuestion(long long id, char* q, char* a, char* b, char* c, char* d,
                  char correct, int difficulty);
-Question* getQuestionById(int id);
+Question* getQuestionById(long long id);
 void displayQuestion(Question* q);
 void initializeSampleQuestions();
 
+// Rendered output
+void renderQuestions(void);
+void freeRenderedQuestions(void);
+const char* renderedQuestion(int slot, RenderKind kind, size_t* length);
+void writeOutput(const char* data, size_t length);
+void outputAppend(OutputBuffer* out, const char* data, size_t length);
+void outputFlush(OutputBuffer* out);
+
+// Question bank storage
+char* mapFile(const char* path, size_t* size);
+char* mapFileWritable(const char* path, size_t* size);
+void unmapFile(char* data, size_t size);
+const char* textOf(TextRef ref);
+TextRef appendText(const char* s);
+Question* reserveQuestion(void);
+uint64_t hashQuestionId(long long id);
+int findQuestionSlot(long long id);
+int insertQuestionId(long long id, int slot);
+void freeQuestionIdIndex(void);
+int loadQuestionBank(const char* path);
+void freeQuestionBank(void);
+void refreshBankIndexes(void);
+void freeBankIndexes(void);
+int emitEmbeddedBank(const char* path);
+void installEmbeddedBank(const EmbeddedBank* bank);
+
+// Engine snapshots
+uint64_t bankFingerprint(const char* bankPath);
+uint64_t snapshotChecksum(const unsigned char* data, size_t size);
+int writeSnapshot(const char* path, uint64_t fingerprint);
+void maybeWriteSnapshot(void);
+void waitSnapshotWriter(void);
+int restoreSnapshot(const char* path, uint64_t fingerprint);
+
 // Performance operations
-void trackAnswer(Question* q, char userAnswer);
-void evaluateResults();
-void displayResults();
+int trackAnswer(ExamSession* s, Question* q, char userAnswer, uint64_t timeNs);
+void evaluateResults(ExamSession* s);
+void displayResults(const ExamSession* s);
 
 // Exam statistics operations
-void updateStats(int isCorrect, int difficulty, float time);
+void updateStats(ExamStats* stats, int isCorrect, int difficulty, uint64_t timeNs);
 void displayStatistics();
-void resetStats();
+void resetStats(ExamSession* s);
+void recordExamResult(const ExamStats* stats);
 void displayExamHistory();
 
+// Report aggregates
+void countBankQuestion(int difficulty);
+void resetBankAggregates(void);
+void countExam(float score);
+void updateSlowQuestions(const Question* q);
+void rankSlowQuestions(void);
+
+// Exam history log
+int openHistoryLog(const char* path);
+void closeHistoryLog(void);
+int appendExamRecord(const ExamStats* stats);
+int appendExamRecords(const ExamRecord* records, int count);
+const ExamRecord* mapHistoryRecords(char** mapping, size_t* mappedSize, long long* count);
+float recordScore(const ExamRecord* record);
+
+// Response log
+int openResponseLog(const char* path);
+void closeResponseLog(void);
+int appendResponses(const ResponseRecord* records, int count);
+void recordResponse(ExamSession* s, const Question* q, char answer, int isCorrect, uint64_t timeNs);
+
+// Response timing
+uint64_t monotonicNs(void);
+uint64_t secondsToNs(double seconds);
+int histogramIndex(uint64_t value, int subBits);
+uint64_t histogramLowerBound(int index, int subBits);
+uint64_t histogramPercentile(const uint32_t* buckets, int bucketCount, int subBits,
+                             uint64_t count, double p);
+void recordLatency(LatencyHistogram* h, uint64_t ns);
+void recordQuestionLatency(const Question* q, uint64_t ns);
+uint64_t questionLatencyMedian(const Question* q);
+void formatDuration(uint64_t ns, char* buffer, size_t size);
+void displayLatencyHistogram(const LatencyHistogram* h);
+
+// Exam engine
+void initSession(ExamSession* s);
+int startSession(ExamSession* s, int numQuestions, ExamMode mode);
+Question* sessionNextQuestion(ExamSession* s);
+AnswerResult submitAnswer(ExamSession* s, char answer);
+int expireSession(ExamSession* s, uint64_t nowNs);
+void finishSession(ExamSession* s);
+void abandonSession(ExamSession* s);
+void freeSession(ExamSession* s);
+
+// Timer wheel
+void initTimerWheel(TimerWheel* w, uint64_t nowNs);
+void armTimer(TimerWheel* w, TimerEntry* e, uint64_t deadlineNs);
+void cancelTimer(TimerWheel* w, TimerEntry* e);
+int advanceTimerWheel(TimerWheel* w, uint64_t nowNs, TimerCallback callback, void* context);
+int64_t timerWheelWaitNs(const TimerWheel* w, uint64_t nowNs);
+
+// Network front-end
+int runExamServer(int port);
+
+// Thread pool
+int hardwareThreads(void);
+void acquireFlag(atomic_flag* flag);
+void releaseFlag(atomic_flag* flag);
+void parallelFor(int workerCount, int taskCount, TaskFunction function, void* context);
+
+// Answer event pipeline
+int initAnswerQueue(size_t capacity);
+int tryPublishAnswerEvent(const AnswerEvent* event);
+void publishAnswerEvent(const AnswerEvent* event);
+void applyAnswerEvent(const AnswerEvent* event);
+int startAnswerAggregator(void);
+void flushAnswerEvents(void);
+void stopAnswerAggregator(void);
+
+// Batch grading
+int loadAnswerForms(GradeJob* job);
+const AnswerForm* findAnswerForm(const GradeJob* job, int id);
+int gradeSheet(GradeJob* job, GradeWorker* worker, const char* line, const char* end);
+int runBatchGrading(const char* path, int threadCount);
+
+// Item analysis
+int runItemAnalysis(const char* path, int threadCount, const char* reportPath);
+
+// Collusion check
+int runCollusionCheck(const char* path, int threadCount, int topLimit, const char* reportPath);
+
+// Near-duplicate detection
+int runDuplicateCheck(double similarity, int threadCount, const char* clustersPath);
+
+// Form assembly
+int runFormAssembly(int formCount, int formLength, const long* mixPercent, int maxOverlap,
+                    int threadCount, const char* outPath);
+
 // Core exam functionalities
 void startExam();
 void takeAdaptiveExam();
@@ -112,14 +947,139 @@ void takeAdaptiveExam();
 void viewQuestionBank();
 void viewPerformanceAnalysis();
 void viewDifficultyStatistics();
+void searchQuestionBank();
 
 // Helpers for adaptive logic
-TreeNode* findStartNode(TreeNode* root, int preferredDifficulty);
-Question* getNextUnaskedQuestion(int difficulty, int usedFlags[]);
-Question* getAnyUnaskedQuestion(int usedFlags[]);
+int findStartNode(const AdaptiveTree* tree, int preferredDifficulty);
+Question* getNextUnaskedQuestion(int difficulty, AskedSet* asked);
+Question* getAnyUnaskedQuestion(AskedSet* asked);
+Question* pickTreeQuestion(int currentNode, AskedSet* asked);
+int nextTreeNode(int currentNode, AnswerResult result, const AskedSet* asked);
+
+// Keyword search
+int buildSearchIndex(void);
+void freeSearchIndex(void);
+int searchQuestions(const char* query, int* slots, int maxSlots);
+
+// Decision path table
+void buildPathTable(void);
+void freePathTable(void);
+
+// Availability index
+void buildDifficultyIndex(void);
+void freeDifficultyIndex(void);
+int initAskedSet(AskedSet* asked, int slotCount);
+void freeAskedSet(AskedSet* asked);
+void clearAskedSet(AskedSet* asked);
+int markAsked(AskedSet* asked, int slot);
+int isAsked(const AskedSet* asked, int slot);
+
+// Item response theory
+void setDefaultIrtParameters(Question* q);
+double irtProbability(const Question* q, double theta);
+double irtInformation(const Question* q, double theta);
+double irtPeakTheta(const Question* q);
+void buildIrtIndex(void);
+void freeIrtIndex(void);
+Question* selectIrtQuestion(ExamSession* s);
+void initAbilityEstimate(ExamSession* s);
+void updateAbilityEstimate(ExamSession* s, const Question* q, int isCorrect);
 
-int main() {
+#ifndef EXAM_SYSTEM_NO_MAIN
+int main(int argc, char* argv[]) {
     int choice;
+    const char* bankPath = NULL;
+    int serverPort = 0;
+    const char* historyFile = DEFAULT_HISTORY_PATH;
+    const char* gradePath = NULL;
+    const char* emitPath = NULL;
+    int threadCount = 0;
+    int restored = 0;
+    int assembleCount = 0;
+    int formLength = FORM_DEFAULT_LENGTH;
+    int maxOverlap = -1;
+    long mix[4] = {0};
+    int mixGiven = 0;
+    const char* formsPath = NULL;
+    const char* responseFile = DEFAULT_RESPONSE_PATH;
+    int itemAnalysis = 0;
+    const char* reportPath = NULL;
+    int collusionCheck = 0;
+    int topPairs = COLLUSION_DEFAULT_TOP;
+    int dedupCheck = 0;
+    double similarity = DEDUP_DEFAULT_SIMILARITY;
+    const char* clustersPath = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--bank") == 0 && i + 1 < argc) {
+            bankPath = argv[++i];
+        } else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+            serverPort = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--history") == 0 && i + 1 < argc) {
+            historyFile = argv[++i];
+        } else if (strcmp(argv[i], "--grade") == 0 && i + 1 < argc) {
+            gradePath = argv[++i];
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threadCount = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--emit-bank") == 0 && i + 1 < argc) {
+            emitPath = argv[++i];
+        } else if (strcmp(argv[i], "--snapshot") == 0 && i + 1 < argc) {
+            snapshotPath = argv[++i];
+        } else if (strcmp(argv[i], "--assemble") == 0 && i + 1 < argc) {
+            assembleCount = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--form-length") == 0 && i + 1 < argc) {
+            formLength = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--max-overlap") == 0 && i + 1 < argc) {
+            maxOverlap = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--mix") == 0 && i + 1 < argc &&
+                   sscanf(argv[i + 1], "%ld:%ld:%ld", &mix[1], &mix[2], &mix[3]) == 3) {
+            mixGiven = 1;
+            i++;
+        } else if (strcmp(argv[i], "--forms-out") == 0 && i + 1 < argc) {
+            formsPath = argv[++i];
+        } else if (strcmp(argv[i], "--responses") == 0 && i + 1 < argc) {
+            responseFile = argv[++i];
+        } else if (strcmp(argv[i], "--item-analysis") == 0) {
+            itemAnalysis = 1;
+        } else if (strcmp(argv[i], "--report") == 0 && i + 1 < argc) {
+            reportPath = argv[++i];
+        } else if (strcmp(argv[i], "--collusion") == 0) {
+            collusionCheck = 1;
+        } else if (strcmp(argv[i], "--top") == 0 && i + 1 < argc) {
+            topPairs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--dedup") == 0) {
+            dedupCheck = 1;
+        } else if (strcmp(argv[i], "--similarity") == 0 && i + 1 < argc) {
+            similarity = atof(argv[++i]);
+            if (similarity <= 0.0 || similarity > 1.0) similarity = DEDUP_DEFAULT_SIMILARITY;
+        } else if (strcmp(argv[i], "--clusters-out") == 0 && i + 1 < argc) {
+            clustersPath = argv[++i];
+        } else if (strcmp(argv[i], "--time-limit") == 0 && i + 1 < argc) {
+            examTimeLimitNs = secondsToNs(atof(argv[++i]));
+        } else if (strcmp(argv[i], "--question-time") == 0 && i + 1 < argc) {
+            questionTimeLimitNs = secondsToNs(atof(argv[++i]));
+        } else if (strcmp(argv[i], "--idle-timeout") == 0 && i + 1 < argc) {
+            idleTimeoutNs = secondsToNs(atof(argv[++i]));
+        } else {
+            printf("Usage: %s [--bank FILE] [--history FILE] [--responses FILE] [--snapshot FILE] [--serve PORT]\n"
+                   "          [--time-limit SECONDS] [--question-time SECONDS] [--idle-timeout SECONDS]\n"
+                   "          [--grade FILE [--threads N]] [--dedup [--similarity S] [--clusters-out FILE]]\n"
+                   "       %s [--bank FILE] --emit-bank HEADER\n"
+                   "       %s [--bank FILE] --assemble N [--form-length L] [--mix E:M:H] [--max-overlap K]\n"
+                   "          [--threads N] [--forms-out FILE]\n"
+                   "       %s [--bank FILE] [--responses FILE] --item-analysis [--threads N] [--report FILE]\n"
+                   "       %s [--responses FILE] --collusion [--top K] [--threads N] [--report FILE]\n",
+                   argv[0], argv[0], argv[0], argv[0], argv[0]);
+            return 1;
+        }
+    }
+
+#ifndef _WIN32
+    if (examTimeLimitNs > 0 || questionTimeLimitNs > 0) {
+        // Console answers wait in poll(), which cannot see a stdio buffer
+        setvbuf(stdin, NULL, _IONBF, 0);
+    }
+#endif
 
     printf("=================================================================\n");
     printf("       ONLINE EXAMINATION SYSTEM WITH ADAPTIVE FLOW\n");
@@ -127,12 +1087,80 @@ int main() {
 
     // Initialize
     questionQueue = createQueue();
-    adaptiveTree = NULL;
-    resetStats();
-    initializeSampleQuestions();
-    buildAdaptiveTree(&adaptiveTree, questions, questionCount);
+    adaptiveTree.slots = NULL;
+    adaptiveTree.size = 0;
+    initSession(&consoleSession);
+    snapshotFingerprint = bankFingerprint(bankPath);
+    if (snapshotPath != NULL) {
+        uint64_t start = monotonicNs();
+        if (restoreSnapshot(snapshotPath, snapshotFingerprint) == 0) {
+            restored = 1;
+            snapshotWrittenAt = time(NULL);
+            printf("Restored %d questions from snapshot %s in %.2f ms\n", questionCount, snapshotPath,
+                   (monotonicNs() - start) / 1e6);
+        }
+    }
+    if (restored) {
+        // Bank, indexes and statistics all came from the snapshot
+    } else if (bankPath != NULL) {
+        if (loadQuestionBank(bankPath) < 0) {
+            return 1;
+        }
+        printf("Loaded %d questions from %s\n", questionCount, bankPath);
+    } else {
+#ifdef EMBEDDED_BANK
+        installEmbeddedBank(&embeddedBank);
+#else
+        initializeSampleQuestions();
+#endif
+    }
+    refreshBankIndexes();
+    if (dedupCheck) runDuplicateCheck(similarity, threadCount, clustersPath);
+    if (emitPath != NULL) {
+        int status = emitEmbeddedBank(emitPath);
+        freeBankIndexes();
+        freeQueue(questionQueue);
+        freeQuestionBank();
+        return status == 0 ? 0 : 1;
+    }
+    if (itemAnalysis || collusionCheck) {
+        int status = itemAnalysis ? runItemAnalysis(responseFile, threadCount, reportPath)
+                                  : runCollusionCheck(responseFile, threadCount, topPairs, reportPath);
+        freeBankIndexes();
+        freeQueue(questionQueue);
+        freeQuestionBank();
+        return status == 0 ? 0 : 1;
+    }
+    if (openHistoryLog(historyFile) != 0) {
+        printf("Exam history will not be saved.\n");
+    }
+    if (assembleCount == 0 && openResponseLog(responseFile) != 0) {
+        printf("Responses will not be saved for item analysis.\n");
+    }
+    if (gradePath == NULL && assembleCount == 0 && startAnswerAggregator() != 0) {
+        printf("Answer statistics will be updated inline.\n");
+    }
+
+    if (gradePath != NULL || serverPort > 0 || assembleCount > 0) {
+        int status = gradePath != NULL ? runBatchGrading(gradePath, threadCount)
+                   : assembleCount > 0 ? runFormAssembly(assembleCount, formLength, mixGiven ? mix : NULL,
+                                                         maxOverlap, threadCount, formsPath)
+                                       : runExamServer(serverPort);
+        stopAnswerAggregator();
+        waitSnapshotWriter();
+        if (snapshotPath != NULL) writeSnapshot(snapshotPath, snapshotFingerprint);
+        closeHistoryLog();
+        closeResponseLog();
+        freeBankIndexes();
+        freeQueue(questionQueue);
+        freeSession(&consoleSession);
+        freeQuestionBank();
+        return status == 0 ? 0 : 1;
+    }
+    buildSearchIndex();
 
     while (1) {
+        maybeWriteSnapshot();
         printf("\n===========================================\n");
         printf("            MAIN MENU\n");
         printf("===========================================\n");
@@ -141,7 +1169,8 @@ int main() {
         printf("3. View Performance Analysis\n");
         printf("4. View Difficulty Statistics\n");
         printf("5. View Exam History\n");
-        printf("6. Exit\n");
+        printf("6. Search Questions\n");
+        printf("7. Exit\n");
         printf("===========================================\n");
         printf("Enter your choice: ");
 
@@ -169,13 +1198,19 @@ int main() {
                 displayExamHistory();
                 break;
             case 6:
+                searchQuestionBank();
+                break;
+            case 7:
                 printf("\nThank you for using the system! Goodbye!\n");
-                if (adaptiveTree) freeTree(adaptiveTree);
-                // Free any remaining queue nodes
-                while (!isQueueEmpty(questionQueue)) {
-                    dequeue(questionQueue);
-                }
-                free(questionQueue);
+                stopAnswerAggregator();
+                waitSnapshotWriter();
+                if (snapshotPath != NULL) writeSnapshot(snapshotPath, snapshotFingerprint);
+                closeHistoryLog();
+                closeResponseLog();
+                freeBankIndexes();
+                freeQueue(questionQueue);
+                freeSession(&consoleSession);
+                freeQuestionBank();
                 exit(0);
             default:
                 printf("\nInvalid choice! Please try again.\n");
@@ -184,6 +1219,7 @@ int main() {
 
     return 0;
 }
+#endif
 
 // Helper: flush rest of line from stdin
 void flushInput(void) {
@@ -194,25 +1230,30 @@ void flushInput(void) {
 // Queue Implementation
 Queue* createQueue() {
     Queue* q = (Queue*)malloc(sizeof(Queue));
-    q->front = NULL;
-    q->rear = NULL;
+    q->capacity = 16;
+    q->items = (Question**)malloc(sizeof(Question*) * q->capacity);
+    q->head = 0;
     q->count = 0;
     return q;
 }
 
-void enqueue(Queue* q, Question* question) {
-    QueueNode* newNode = (QueueNode*)malloc(sizeof(QueueNode));
-    newNode->question = question;
-    newNode->next = NULL;
-
-    if (q->rear == NULL) {
-        q->front = newNode;
-        q->rear = newNode;
-    } else {
-        q->rear->next = newNode;
-        q->rear = newNode;
+// Returns -1 when the queue cannot grow
+int enqueue(Queue* q, Question* question) {
+    if (q->count == q->capacity) {
+        // Double and unwrap so the live items start at index 0 again
+        Question** items = (Question**)malloc(sizeof(Question*) * q->capacity * 2);
+        if (items == NULL) return -1;
+        for (int i = 0; i < q->count; i++) {
+            items[i] = q->items[(q->head + i) & (q->capacity - 1)];
+        }
+        free(q->items);
+        q->items = items;
+        q->capacity *= 2;
+        q->head = 0;
     }
+    q->items[(q->head + q->count) & (q->capacity - 1)] = question;
     q->count++;
+    return 0;
 }
 
 Question* dequeue(Queue* q) {
@@ -220,95 +1261,143 @@ Question* dequeue(Queue* q) {
         return NULL;
     }
 
-    QueueNode* temp = q->front;
-    Question* question = temp->question;
-    q->front = q->front->next;
-
-    if (q->front == NULL) {
-        q->rear = NULL;
-    }
-
-    free(temp);
+    Question* question = q->items[q->head];
+    q->head = (q->head + 1) & (q->capacity - 1);
     q->count--;
     return question;
 }
 
 int isQueueEmpty(Queue* q) {
-    return q->front == NULL;
+    return q->count == 0;
 }
 
-// Binary Tree Implementation
-TreeNode* createTreeNode(Question* question) {
-    TreeNode* node = (TreeNode*)malloc(sizeof(TreeNode));
-    node->question = question;
-    node->left = NULL;
-    node->right = NULL;
-    return node;
+void clearQueue(Queue* q) {
+    q->head = 0;
+    q->count = 0;
 }
 
-void buildAdaptiveTree(TreeNode** root, Question* questions, int n) {
-    int i;
-    for (i = 0; i < n; i++) {
-        *root = insertQuestion(*root, &questions[i]);
-    }
+void freeQueue(Queue* q) {
+    if (q == NULL) return;
+    free(q->items);
+    free(q);
 }
 
-TreeNode* insertQuestion(TreeNode* root, Question* question) {
-    if (root == NULL) {
-        return createTreeNode(question);
+// Binary Tree Implementation
+// Deepest path is log2(n) + 1 nodes, so a small fixed stack is enough
+#define TREE_MAX_DEPTH 64
+
+// Orders the bank hardest-first with a stable counting sort (O(n)) and lays
+// it out in Eytzinger order with an iterative in-order walk.
+void buildAdaptiveTree(AdaptiveTree* tree, const unsigned char* difficulty, int n) {
+    int start[5] = {0};
+    int stack[TREE_MAX_DEPTH];
+    int top = 0, node = 0, k = 0;
+
+    freeTree(tree);
+    if (n <= 0) return;
+
+    int* sorted = (int*)malloc(sizeof(int) * n);
+    tree->slots = (int*)malloc(sizeof(int) * n);
+    if (sorted == NULL || tree->slots == NULL) {
+        printf("Out of memory building the adaptive tree!\n");
+        free(sorted);
+        freeTree(tree);
+        return;
+    }
+
+    // Buckets for difficulty 3, 2, 1 and anything else, in that order
+    for (int i = 0; i < n; i++) {
+        int d = difficulty[i];
+        start[((d >= 1 && d <= 3) ? 3 - d : 3) + 1]++;
+    }
+    for (int b = 1; b < 5; b++) start[b] += start[b - 1];
+    for (int i = 0; i < n; i++) {
+        int d = difficulty[i];
+        sorted[start[(d >= 1 && d <= 3) ? 3 - d : 3]++] = i;
     }
 
-    // Insert based on difficulty: left for harder (bigger), right for easier (smaller or equal)
-    if (question->difficulty > root->question->difficulty) {
-        root->left = insertQuestion(root->left, question);
-    } else {
-        root->right = insertQuestion(root->right, question);
+    while (top > 0 || node < n) {
+        while (node < n) {
+            stack[top++] = node;
+            node = 2 * node + 1;
+        }
+        node = stack[--top];
+        tree->slots[node] = sorted[k++];
+        node = 2 * node + 2;
     }
 
-    return root;
+    tree->size = n;
+    free(sorted);
 }
 
-// inorder traversal enqueues the questions (used for inspection or fallback)
-void traverseTree(TreeNode* root, Queue* q) {
-    if (root == NULL) return;
-    traverseTree(root->left, q);
-    enqueue(q, root->question);
-    traverseTree(root->right, q);
+int treeLeft(const AdaptiveTree* tree, int node) {
+    int child = 2 * node + 1;
+    return (node >= 0 && child < tree->size) ? child : -1;
 }
 
-void freeTree(TreeNode* root) {
-    if (root != NULL) {
-        freeTree(root->left);
-        freeTree(root->right);
-        free(root);
+int treeRight(const AdaptiveTree* tree, int node) {
+    int child = 2 * node + 2;
+    return (node >= 0 && child < tree->size) ? child : -1;
+}
+
+Question* treeQuestion(const AdaptiveTree* tree, int node) {
+    return &questions[tree->slots[node]];
+}
+
+// inorder traversal enqueues the questions (used for inspection or fallback);
+// returns -1 when the queue runs out of memory
+int traverseTree(const AdaptiveTree* tree, Queue* q) {
+    int stack[TREE_MAX_DEPTH];
+    int top = 0, node = 0;
+
+    while (top > 0 || node < tree->size) {
+        while (node < tree->size) {
+            stack[top++] = node;
+            node = 2 * node + 1;
+        }
+        node = stack[--top];
+        if (enqueue(q, treeQuestion(tree, node)) != 0) return -1;
+        node = 2 * node + 2;
     }
+    return 0;
+}
+
+void freeTree(AdaptiveTree* tree) {
+    free(tree->slots);
+    tree->slots = NULL;
+    tree->size = 0;
 }
 
 // Question Management
-void addQuestion(int id, char* q, char* a, char* b, char* c, char* d,
+void addQuestion(long long id, char* q, char* a, char* b, char* c, char* d,
                  char correct, int difficulty) {
-    if (questionCount >= MAX_QUESTIONS) {
+    if (findQuestionSlot(id) >= 0) {
+        printf("Question %lld is already in the bank!\n", id);
+        return;
+    }
+    Question* question = reserveQuestion();
+    if (question == NULL || insertQuestionId(id, questionCount) != 0) {
         printf("Question bank is full!\n");
         return;
     }
 
-    questions[questionCount].id = id;
-    strncpy(questions[questionCount].question, q, sizeof(questions[questionCount].question)-1);
-    questions[questionCount].question[sizeof(questions[questionCount].question)-1] = '\0';
-    strncpy(questions[questionCount].optionA, a, sizeof(questions[questionCount].optionA)-1);
-    questions[questionCount].optionA[sizeof(questions[questionCount].optionA)-1] = '\0';
-    strncpy(questions[questionCount].optionB, b, sizeof(questions[questionCount].optionB)-1);
-    questions[questionCount].optionB[sizeof(questions[questionCount].optionB)-1] = '\0';
-    strncpy(questions[questionCount].optionC, c, sizeof(questions[questionCount].optionC)-1);
-    questions[questionCount].optionC[sizeof(questions[questionCount].optionC)-1] = '\0';
-    strncpy(questions[questionCount].optionD, d, sizeof(questions[questionCount].optionD)-1);
-    questions[questionCount].optionD[sizeof(questions[questionCount].optionD)-1] = '\0';
-    questions[questionCount].correctAnswer = toupper((unsigned char)correct);
-    questions[questionCount].difficulty = difficulty;
-    questions[questionCount].attempts = 0;
-    questions[questionCount].correctCount = 0;
+    question->id = id;
+    question->question = appendText(q);
+    question->optionA = appendText(a);
+    question->optionB = appendText(b);
+    question->optionC = appendText(c);
+    question->optionD = appendText(d);
+    question->correctAnswer = toupper((unsigned char)correct);
+    question->difficulty = difficulty;
+    setDefaultIrtParameters(question);
+    questionLatency[questionCount] = NULL;
+    questionDifficulty[questionCount] = (unsigned char)difficulty;
+    atomic_init(&questionAttempts[questionCount], 0);
+    atomic_init(&questionCorrect[questionCount], 0);
 
     questionCount++;
+    countBankQuestion(difficulty);
+    bankVersion++;
 }
 
 void initializeSampleQuestions() {
@@ -329,303 +1418,4667 @@ void initializeSampleQuestions() {
     addQuestion(10, "Who proved Fermat's Last Theorem?", "Einstein", "Gauss", "Andrew Wiles", "Euler", 'C', 3);
 }
 
-Question* getQuestionById(int id) {
-    int i;
-    for (i = 0; i < questionCount; i++) {
-        if (questions[i].id == id) {
-            return &questions[i];
-        }
-    }
-    return NULL;
+Question* getQuestionById(long long id) {
+    int slot = findQuestionSlot(id);
+    return slot >= 0 ? &questions[slot] : NULL;
 }
 
-void displayQuestion(Question* q) {
-    printf("\n---------------------------------------\n");
-    printf("Question ID: %d\n", q->id);
-    printf("Difficulty: %s\n", q->difficulty == 1 ? "Easy" :
-                               q->difficulty == 2 ? "Medium" : "Hard");
-    printf("\n%s\n", q->question);
-    printf("A) %s\n", q->optionA);
-    printf("B) %s\n", q->optionB);
-    printf("C) %s\n", q->optionC);
-    printf("D) %s\n", q->optionD);
-    printf("---------------------------------------\n");
+// Question Id Index
+uint64_t hashQuestionId(long long id) {
+    // splitmix64 finalizer: sequential and sparse ids both spread evenly
+    uint64_t x = (uint64_t)id;
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
 }
 
-// Performance Tracking
-void trackAnswer(Question* q, char userAnswer) {
-    if (performanceCount >= MAX_QUESTIONS) {
-        return;
-    }
-
-    performances[performanceCount].questionId = q->id;
-    performances[performanceCount].userAnswer = toupper((unsigned char)userAnswer);
-    performances[performanceCount].correctAnswer = q->correctAnswer;
-    performances[performanceCount].isCorrect = (performances[performanceCount].userAnswer == q->correctAnswer);
-    performances[performanceCount].timeSpent = 1.0f; // Simplified time tracking
-
-    q->attempts++;
-    if (performances[performanceCount].isCorrect) {
-        q->correctCount++;
+// Returns the bank slot holding id, or -1
+int findQuestionSlot(long long id) {
+    if (questionIdCapacity == 0) return -1;
+    uint64_t mask = (uint64_t)questionIdCapacity - 1;
+    for (uint64_t i = hashQuestionId(id) & mask;; i = (i + 1) & mask) {
+        if (questionIdIndex[i].slot < 0) return -1;
+        if (questionIdIndex[i].id == id) return questionIdIndex[i].slot;
     }
-
-    updateStats(performances[performanceCount].isCorrect, q->difficulty, 1.0f);
-    performanceCount++;
 }
 
-void evaluateResults() {
-    printf("\n\n===========================================\n");
-    printf("          EXAM RESULTS SUMMARY\n");
-    printf("===========================================\n");
-    printf("Total Questions: %d\n", currentStats.totalQuestions);
-    printf("Correct Answers: %d\n", currentStats.correctAnswers);
-    printf("Wrong Answers: %d\n", currentStats.wrongAnswers);
-    printf("Skipped Questions: %d\n", currentStats.skippedQuestions);
-    if (currentStats.totalQuestions > 0) {
-        printf("Average Score: %.2f%%\n",
-               (float)currentStats.correctAnswers / currentStats.totalQuestions * 100.0f);
-    } else {
-        printf("Average Score: N/A\n");
+// Returns -1 if id is already present or the index cannot grow
+int insertQuestionId(long long id, int slot) {
+    if ((questionCount + 1) * 2 > questionIdCapacity) {
+        int newCapacity = questionIdCapacity ? questionIdCapacity * 2 : 128;
+        QuestionIdEntry* grown = (QuestionIdEntry*)malloc(sizeof(QuestionIdEntry) * newCapacity);
+        if (grown == NULL) return -1;
+        for (int i = 0; i < newCapacity; i++) grown[i].slot = -1;
+        for (int i = 0; i < questionIdCapacity; i++) {
+            if (questionIdIndex[i].slot < 0) continue;
+            uint64_t j = hashQuestionId(questionIdIndex[i].id) & (uint64_t)(newCapacity - 1);
+            while (grown[j].slot >= 0) j = (j + 1) & (uint64_t)(newCapacity - 1);
+            grown[j] = questionIdIndex[i];
+        }
+        free(questionIdIndex);
+        questionIdIndex = grown;
+        questionIdCapacity = newCapacity;
     }
-    printf("Average Difficulty: %.2f\n", currentStats.averageDifficulty);
-    printf("===========================================\n");
 
-    // Store exam in history
-    if (totalExamsTaken < 10) {
-        allExams[totalExamsTaken] = currentStats;
-        totalExamsTaken++;
+    uint64_t mask = (uint64_t)questionIdCapacity - 1;
+    uint64_t i = hashQuestionId(id) & mask;
+    while (questionIdIndex[i].slot >= 0) {
+        if (questionIdIndex[i].id == id) return -1;
+        i = (i + 1) & mask;
     }
+    questionIdIndex[i].id = id;
+    questionIdIndex[i].slot = slot;
+    return 0;
 }
 
-void displayResults() {
-    int i;
-    printf("\n\n===========================================\n");
-    printf("          DETAILED RESULTS\n");
-    printf("===========================================\n");
+void freeQuestionIdIndex(void) {
+    free(questionIdIndex);
+    questionIdIndex = NULL;
+    questionIdCapacity = 0;
+}
 
-    for (i = 0; i < performanceCount; i++) {
-        printf("Question %d: ", performances[i].questionId);
-        printf("Your answer: %c, ", performances[i].userAnswer);
-        printf("Correct: %c, ", performances[i].correctAnswer);
-        printf("Status: %s\n", performances[i].isCorrect ? "CORRECT" : "WRONG");
+// Question Bank Storage
+// Question text lives in one arena and each Question holds offset/length
+// views into it. A loaded bank file is mapped as-is and becomes the arena,
+// so loading never copies or truncates any field.
+static char* mapFileWith(const char* path, size_t* size, int writable) {
+#ifdef _WIN32
+    (void)writable;
+    FILE* f = fopen(path, "rb");
+    if (f == NULL) return NULL;
+    fseek(f, 0, SEEK_END);
+    long length = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if (length <= 0) {
+        fclose(f);
+        return NULL;
     }
+    char* data = (char*)malloc((size_t)length);
+    if (data == NULL || fread(data, 1, (size_t)length, f) != (size_t)length) {
+        free(data);
+        fclose(f);
+        return NULL;
+    }
+    fclose(f);
+    *size = (size_t)length;
+    return data;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return NULL;
+    }
+    // Private mapping: writes stay in this process and only copy the pages
+    // they touch
+    int protection = writable ? PROT_READ | PROT_WRITE : PROT_READ;
+    void* data = mmap(NULL, (size_t)st.st_size, protection, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return NULL;
+    *size = (size_t)st.st_size;
+    return (char*)data;
+#endif
 }
 
-// Statistics Management
-void resetStats() {
-    currentStats.totalQuestions = 0;
-    currentStats.correctAnswers = 0;
-    currentStats.wrongAnswers = 0;
-    currentStats.skippedQuestions = 0;
-    currentStats.averageDifficulty = 0.0f;
-    currentStats.timeTaken = 0.0f;
-    performanceCount = 0;
+// Maps a whole file read-only; NULL if it is missing or empty
+char* mapFile(const char* path, size_t* size) {
+    return mapFileWith(path, size, 0);
 }
 
-void updateStats(int isCorrect, int difficulty, float time) {
-    currentStats.totalQuestions++;
-    currentStats.timeTaken += time;
-
-    if (isCorrect) {
-        currentStats.correctAnswers++;
-    } else {
-        currentStats.wrongAnswers++;
-    }
+// Maps a whole file copy-on-write, for a restored snapshot whose counters
+// are updated in place
+char* mapFileWritable(const char* path, size_t* size) {
+    return mapFileWith(path, size, 1);
+}
 
-    // Update average difficulty incrementally
-    currentStats.averageDifficulty =
-        ((currentStats.averageDifficulty * (currentStats.totalQuestions - 1)) + difficulty) /
-        currentStats.totalQuestions;
+void unmapFile(char* data, size_t size) {
+    if (data == NULL) return;
+#ifdef _WIN32
+    (void)size;
+    free(data);
+#else
+    munmap(data, size);
+#endif
 }
 
-// Helpers for adaptive logic
-TreeNode* findStartNode(TreeNode* root, int preferredDifficulty) {
-    if (root == NULL) return NULL;
-    if (root->question->difficulty == preferredDifficulty) return root;
-    TreeNode* leftSearch = findStartNode(root->left, preferredDifficulty);
-    if (leftSearch) return leftSearch;
-    return findStartNode(root->right, preferredDifficulty);
+const char* textOf(TextRef ref) {
+    return bankText + ref.offset;
 }
 
-Question* getNextUnaskedQuestion(int difficulty, int usedFlags[]) {
-    for (int i = 0; i < questionCount; ++i) {
-        if (!usedFlags[i] && questions[i].difficulty == difficulty) {
-            return &questions[i];
+// Copies a string to the end of the heap arena. A mapped arena is moved to
+// the heap first, so questions can still be added after loading a file.
+TextRef appendText(const char* s) {
+    TextRef ref;
+    size_t length = strlen(s);
+
+    if (bankTextSize + length > bankTextCapacity) {
+        size_t newCapacity = bankTextCapacity ? bankTextCapacity : 4096;
+        while (newCapacity < bankTextSize + length) newCapacity *= 2;
+        char* arena = (char*)malloc(newCapacity);
+        if (arena == NULL) {
+            printf("Out of memory for question text!\n");
+            exit(1);
+        }
+        if (bankTextSize > 0) memcpy(arena, bankText, bankTextSize);
+        if (bankTextCapacity == 0) {
+            unmapFile(bankText, bankTextSize);
+        } else {
+            free(bankText);
         }
+        bankText = arena;
+        bankTextCapacity = newCapacity;
     }
-    return NULL;
-}
 
-Question* getAnyUnaskedQuestion(int usedFlags[]) {
-    for (int i = 0; i < questionCount; ++i) {
-        if (!usedFlags[i]) return &questions[i];
-    }
-    return NULL;
+    memcpy(bankText + bankTextSize, s, length);
+    ref.offset = (uint32_t)bankTextSize;
+    ref.length = (uint32_t)length;
+    bankTextSize += length;
+    return ref;
 }
 
-// Main adaptive exam functionality
-void takeAdaptiveExam() {
-    int examChoice;
-    printf("\n===========================================\n");
-    printf("     ADAPTIVE EXAMINATION MODE\n");
-    printf("===========================================\n");
-    printf("1. 5 Questions Exam\n");
-    printf("2. 10 Questions Exam\n");
-    printf("Enter your choice: ");
-
-    if (scanf("%d", &examChoice) != 1) {
-        printf("Invalid input. Returning to menu.\n");
-        flushInput();
-        return;
+// Returns the next free slot in the bank, growing the array as needed
+Question* reserveQuestion(void) {
+    if (bankBorrowed) return NULL;
+    if (questionCount == questionCapacity) {
+        int newCapacity = questionCapacity ? questionCapacity * 2 : 64;
+        Question* grown = (Question*)realloc(questions, sizeof(Question) * newCapacity);
+        if (grown == NULL) return NULL;
+        questions = grown;
+        unsigned char* difficulty = (unsigned char*)realloc(questionDifficulty, newCapacity);
+        if (difficulty == NULL) return NULL;
+        questionDifficulty = difficulty;
+        atomic_int* attempts = (atomic_int*)realloc(questionAttempts, sizeof(atomic_int) * newCapacity);
+        if (attempts == NULL) return NULL;
+        questionAttempts = attempts;
+        atomic_int* correct = (atomic_int*)realloc(questionCorrect, sizeof(atomic_int) * newCapacity);
+        if (correct == NULL) return NULL;
+        questionCorrect = correct;
+        QuestionLatency** latency = (QuestionLatency**)realloc(questionLatency, sizeof(QuestionLatency*) * newCapacity);
+        if (latency == NULL) return NULL;
+        questionLatency = latency;
+        questionCapacity = newCapacity;
     }
-    flushInput();
-
-    int numQuestions = (examChoice == 1) ? 5 : 10;
-    if (numQuestions <= 0) numQuestions = 5;
-
-    // Reset
-    while (!isQueueEmpty(questionQueue)) dequeue(questionQueue);
-    resetStats();
+    return &questions[questionCount];
+}
 
-    // Build a queue view of the tree (useful for debugging or non-adaptive flow)
-    traverseTree(adaptiveTree, questionQueue);
+// Splits off the next tab-separated field of a line as a view into the file
+static const char* nextField(const char* p, const char* end, TextRef* field, const char* base) {
+    const char* tab = (const char*)memchr(p, '\t', (size_t)(end - p));
+    const char* fieldEnd = tab ? tab : end;
+    field->offset = (uint32_t)(p - base);
+    field->length = (uint32_t)(fieldEnd - p);
+    return tab ? tab + 1 : NULL;
+}
 
-    // usedFlags to avoid repeating questions in the exam
-    int usedFlags[MAX_QUESTIONS] = {0};
+// Parses a numeric field; the mapping has no terminators, so copy it first
+static int parseFloatField(const char* base, TextRef field, float* value) {
+    char buffer[32];
+    char* end;
+    if (field.length == 0 || field.length >= sizeof(buffer)) return 0;
+    memcpy(buffer, base + field.offset, field.length);
+    buffer[field.length] = '\0';
+    *value = strtof(buffer, &end);
+    return *end == '\0' && isfinite(*value);
+}
 
-    // Find a start node (prefer medium difficulty)
-    TreeNode* currentNode = findStartNode(adaptiveTree, 2);
-    if (currentNode == NULL) {
-        // fallback to root of built tree if no medium found
-        currentNode = adaptiveTree;
+// Parses a decimal (optionally negative) 64-bit id; rejects anything else
+static int parseIdField(const char* base, TextRef field, long long* id) {
+    const char* p = base + field.offset;
+    const char* end = p + field.length;
+    int negative = p < end && *p == '-';
+    uint64_t value = 0;
+    if (negative) p++;
+    if (p == end) return 0;
+    for (; p < end; p++) {
+        if (!isdigit((unsigned char)*p)) return 0;
+        if (value > (UINT64_MAX - 9) / 10) return 0;
+        value = value * 10 + (uint64_t)(*p - '0');
     }
+    if (value > (uint64_t)INT64_MAX + negative) return 0;
+    *id = negative ? (long long)(0 - value) : (long long)value;
+    return 1;
+}
 
-    // If tree has no nodes, fallback to scanning question bank
-    if (currentNode == NULL) {
-        // fallback: enqueue first numQuestions questions
-        for (int i = 0; i < questionCount && i < numQuestions; ++i) {
-            enqueue(questionQueue, &questions[i]);
-        }
-        printf("\nFallback (no tree) — using question bank order.\n");
+// Loads a bank file, one question per line:
+//   id <TAB> difficulty <TAB> answer <TAB> question <TAB> A <TAB> B <TAB> C <TAB> D
+// optionally followed by calibrated IRT parameters:
+//   <TAB> a <TAB> b <TAB> c
+// Blank lines and lines starting with '#' are ignored. The file replaces the
+// current bank and is indexed in a single pass over the mapping.
+int loadQuestionBank(const char* path) {
+    size_t size = 0;
+    char* data = mapFile(path, &size);
+    if (data == NULL) {
+        printf("Cannot open question bank file: %s\n", path);
+        return -1;
+    }
+    if (size > UINT32_MAX) {
+        printf("Question bank file is too large: %s\n", path);
+        unmapFile(data, size);
+        return -1;
     }
 
-    printf("\nExam starting! Good luck!\n\n");
+    freeQuestionBank();
+    bankText = data;
+    bankTextSize = size;
+    bankTextCapacity = 0;
 
-    int asked = 0;
-    while (asked < numQuestions) {
-        Question* q = NULL;
+    const char* p = data;
+    const char* end = data + size;
+    int lineNumber = 0;
+    int rejected = 0;
 
-        if (currentNode != NULL && currentNode->question != NULL && !usedFlags[currentNode->question->id - 1]) {
-            q = currentNode->question;
-        } else {
-            // Try to get unasked question of same difficulty as current node desires
-            int targetDiff = 2;
-            if (currentNode) targetDiff = currentNode->question->difficulty;
-            q = getNextUnaskedQuestion(targetDiff, usedFlags);
-            if (q == NULL) q = getAnyUnaskedQuestion(usedFlags);
-            if (q == NULL) break; // no questions remaining
+    while (p < end) {
+        const char* newline = (const char*)memchr(p, '\n', (size_t)(end - p));
+        const char* lineEnd = newline ? newline : end;
+        const char* next = newline ? newline + 1 : end;
+        lineNumber++;
+
+        if (lineEnd > p && lineEnd[-1] == '\r') lineEnd--;
+        if (lineEnd == p || *p == '#') {
+            p = next;
+            continue;
         }
 
-        if (q == NULL) break;
+        TextRef fields[11];
+        const char* cursor = p;
+        int fieldCount = 0;
+        while (cursor != NULL && fieldCount < 11) {
+            cursor = nextField(cursor, lineEnd, &fields[fieldCount], data);
+            fieldCount++;
+        }
 
-        displayQuestion(q);
-        printf("Enter your answer (A/B/C/D) or S to skip: ");
         char answer = 0;
-        if (scanf(" %c", &answer) != 1) {
-            printf("Invalid input. Skipping question.\n");
-            flushInput();
-            currentStats.skippedQuestions++;
-            updateStats(0, q->difficulty, 1.0f);
-            usedFlags[q->id - 1] = 1;
-            asked++;
+        int difficulty = 0;
+        long long id = 0;
+        int calibrated = fieldCount == 11;
+        float irtA = 0.0f, irtB = 0.0f, irtC = 0.0f;
+        if ((fieldCount == 8 || calibrated) && cursor == NULL) {
+            if (fields[2].length == 1) answer = toupper((unsigned char)data[fields[2].offset]);
+            if (fields[1].length == 1) difficulty = data[fields[1].offset] - '0';
+        }
+        if (calibrated && (!parseFloatField(data, fields[8], &irtA) ||
+                           !parseFloatField(data, fields[9], &irtB) ||
+                           !parseFloatField(data, fields[10], &irtC) ||
+                           irtA <= 0.0f || irtC < 0.0f || irtC >= 1.0f)) {
+            answer = 0;
+        }
+        if (answer < 'A' || answer > 'D' || difficulty < 1 || difficulty > 3 ||
+            !parseIdField(data, fields[0], &id)) {
+            printf("%s:%d: malformed question, skipped\n", path, lineNumber);
+            rejected++;
+            p = next;
             continue;
         }
-        flushInput();
-
-        if (toupper((unsigned char)answer) == 'S') {
-            printf("Question skipped!\n");
-            currentStats.skippedQuestions++;
-            updateStats(0, q->difficulty, 1.0f);
-            usedFlags[q->id - 1] = 1;
-            asked++;
-            // keep currentNode unchanged so next question follows same trend
+        if (findQuestionSlot(id) >= 0) {
+            printf("%s:%d: duplicate question id %lld, skipped\n", path, lineNumber, id);
+            rejected++;
+            p = next;
             continue;
         }
 
-        // Track and respond
-        trackAnswer(q, answer);
-        if (performances[performanceCount - 1].isCorrect) {
-            printf("\nCorrect! Well done!\n");
-            // Adaptive: move to easier (right)
-            if (currentNode && currentNode->right && !usedFlags[currentNode->right->question->id - 1]) {
-                currentNode = currentNode->right;
-            } else {
-                // fallback: pick any unasked question with lower difficulty (if available)
-                if (q->difficulty > 1) {
-                    Question* fallback = getNextUnaskedQuestion(q->difficulty - 1, usedFlags);
-                    if (fallback) {
-                        // find node corresponding to fallback
-                        // simple approach: set currentNode NULL and rely on direct selection next loop
-                        currentNode = NULL;
-                    } else {
-                        currentNode = NULL;
-                    }
-                } else {
-                    currentNode = NULL;
-                }
-            }
+        Question* question = reserveQuestion();
+        if (question == NULL || insertQuestionId(id, questionCount) != 0) {
+            printf("Out of memory while loading %s\n", path);
+            // Leave an empty bank rather than a half-built one
+            freeBankIndexes();
+            freeQuestionBank();
+            return -1;
+        }
+        question->id = id;
+        question->question = fields[3];
+        question->optionA = fields[4];
+        question->optionB = fields[5];
+        question->optionC = fields[6];
+        question->optionD = fields[7];
+        question->correctAnswer = answer;
+        question->difficulty = difficulty;
+        if (calibrated) {
+            question->irtA = irtA;
+            question->irtB = irtB;
+            question->irtC = irtC;
         } else {
-            printf("\nWrong! Correct answer was %c\n", q->correctAnswer);
-            // Adaptive: move to harder (left)
-            if (currentNode && currentNode->left && !usedFlags[currentNode->left->question->id - 1]) {
-                currentNode = currentNode->left;
-            } else {
-                // fallback: pick unasked question with higher difficulty
-                if (q->difficulty < 3) {
-                    Question* fallback = getNextUnaskedQuestion(q->difficulty + 1, usedFlags);
-                    if (fallback) {
-                        currentNode = NULL;
-                    } else {
-                        currentNode = NULL;
-                    }
-                } else {
-                    currentNode = NULL;
-                }
-            }
+            setDefaultIrtParameters(question);
         }
+        questionLatency[questionCount] = NULL;
+        questionDifficulty[questionCount] = (unsigned char)difficulty;
+        atomic_init(&questionAttempts[questionCount], 0);
+        atomic_init(&questionCorrect[questionCount], 0);
+        questionCount++;
+        countBankQuestion(difficulty);
 
-        usedFlags[q->id - 1] = 1;
-        asked++;
-
-        printf("\nPress Enter to continue...");
-        getchar();
+        p = next;
     }
 
-    // Display results
-    evaluateResults();
-    displayResults();
+    if (rejected > 0) {
+        printf("%d malformed or duplicate line(s) ignored in %s\n", rejected, path);
+    }
+    bankVersion++;
+    return questionCount;
+}
 
-    printf("\nPress Enter to return to main menu...");
-    getchar();
+void freeQuestionBank(void) {
+    freeRenderedQuestions();
+    for (int i = 0; i < questionCount; i++) {
+        free(questionLatency[i]);
+        questionLatency[i] = NULL;
+    }
+    free(questionLatency);
+    if (bankBorrowed) {
+        // Compiled-in or snapshot tables: just let go of them
+        questionIdIndex = NULL;
+        questionIdCapacity = 0;
+        unmapFile(snapshotMapping, snapshotSize);
+        snapshotMapping = NULL;
+        snapshotSize = 0;
+    } else {
+        if (bankTextCapacity == 0) {
+            unmapFile(bankText, bankTextSize);
+        } else {
+            free(bankText);
+        }
+        free(questions);
+        free(questionDifficulty);
+        free(questionAttempts);
+        free(questionCorrect);
+        freeQuestionIdIndex();
+    }
+    bankText = NULL;
+    bankTextSize = 0;
+    bankTextCapacity = 0;
+    questions = NULL;
+    questionDifficulty = NULL;
+    questionAttempts = NULL;
+    questionCorrect = NULL;
+    questionLatency = NULL;
+    bankBorrowed = 0;
+    questionCount = 0;
+    questionCapacity = 0;
+    resetBankAggregates();
+    bankVersion++;
 }
 
-// Extra Functionality 1: View Question Bank
-void viewQuestionBank() {
-    int i;
-    printf("\n\n===========================================\n");
-    printf("          QUESTION BANK\n");
-    printf("===========================================\n");
-    printf("Total Questions: %d\n\n", questionCount);
+// Rebuilds everything derived from the bank (difficulty index, adaptive
+// tree, in-order queue view). Does nothing unless the bank
+// changed since the last call, so exams can call it unconditionally.
+void refreshBankIndexes(void) {
+    if (indexedBankVersion == bankVersion) return;
+
+    freeBankIndexes();
+    buildDifficultyIndex();
+    buildIrtIndex();
+    buildAdaptiveTree(&adaptiveTree, questionDifficulty, questionCount);
+    if (questionQueue == NULL) questionQueue = createQueue();
+    clearQueue(questionQueue);
+    if (traverseTree(&adaptiveTree, questionQueue) != 0) {
+        printf("Out of memory building the question queue!\n");
+    }
+
+    indexedBankVersion = bankVersion;
+}
+
+// Frees the derived indexes, or lets go of them if they are borrowed
+void freeBankIndexes(void) {
+    freePathTable();
+    freeSearchIndex();
+    if (indexesBorrowed) {
+        for (int d = 0; d < 4; d++) {
+            difficultySlots[d] = NULL;
+            difficultySlotCount[d] = 0;
+        }
+        adaptiveTree.slots = NULL;
+        adaptiveTree.size = 0;
+        irtIndex = NULL;
+        irtIndexSize = 0;
+        indexesBorrowed = 0;
+        return;
+    }
+    freeDifficultyIndex();
+    freeIrtIndex();
+    freeTree(&adaptiveTree);
+}
+
+// Embedded Banks
+// --emit-bank writes the current bank and all of its indexes as static C
+// tables. Compiling with -DEMBEDDED_BANK='"file.h"' links them into the
+// binary: the read-only tables land in .rodata (shared between processes
+// through the page cache), the counters in .bss, and installEmbeddedBank()
+// only points the globals at them, so startup does no per-question work.
+
+// Writes bytes as a C string literal
+static void emitStringLiteral(FILE* out, const char* text, size_t length) {
+    fputc('"', out);
+    for (size_t i = 0; i < length; i++) {
+        unsigned char ch = (unsigned char)text[i];
+        if (ch == '"' || ch == '\\') fprintf(out, "\\%c", ch);
+        else if (ch < 32 || ch >= 127 || ch == '?') fprintf(out, "\\%03o", ch);
+        else fputc(ch, out);
+    }
+    fputc('"', out);
+}
+
+static void emitIntArray(FILE* out, const char* name, const int* values, int count) {
+    fprintf(out, "static const int %s[] = {", name);
+    for (int i = 0; i < count; i++) fprintf(out, "%s%s%d", i ? "," : "", i % 16 ? "" : "\n    ", values[i]);
+    fprintf(out, "%s\n};\n", count ? "" : "0");
+}
+
+static TextRef emitField(FILE* out, TextRef field, uint32_t* offset) {
+    TextRef ref = {*offset, field.length};
+    emitStringLiteral(out, textOf(field), field.length);
+    *offset += field.length;
+    return ref;
+}
+
+int emitEmbeddedBank(const char* path) {
+    refreshBankIndexes();
+    if (questionCount == 0) {
+        printf("Cannot embed an empty question bank\n");
+        return -1;
+    }
+    FILE* out = fopen(path, "w");
+    if (out == NULL) {
+        printf("Cannot write %s\n", path);
+        return -1;
+    }
+    TextRef* refs = (TextRef*)malloc(sizeof(TextRef) * 5 * (size_t)questionCount);
+    if (refs == NULL) {
+        fclose(out);
+        return -1;
+    }
+
+    fprintf(out, "// Generated by exam_system --emit-bank; do not edit.\n");
+    fprintf(out, "// Build with: gcc -DEMBEDDED_BANK='\"%s\"' exam_system.c -o exam_system -lm -pthread\n\n", path);
+
+    // Text arena holding only the question fields, one question per line
+    uint32_t offset = 0;
+    fprintf(out, "static const char embeddedBankText[] =");
+    for (int i = 0; i < questionCount; i++) {
+        const Question* q = &questions[i];
+        fprintf(out, "\n    ");
+        refs[i * 5 + 0] = emitField(out, q->question, &offset);
+        refs[i * 5 + 1] = emitField(out, q->optionA, &offset);
+        refs[i * 5 + 2] = emitField(out, q->optionB, &offset);
+        refs[i * 5 + 3] = emitField(out, q->optionC, &offset);
+        refs[i * 5 + 4] = emitField(out, q->optionD, &offset);
+    }
+    fprintf(out, ";\n\n");
+
+    fprintf(out, "static const Question embeddedQuestions[] = {\n");
+    for (int i = 0; i < questionCount; i++) {
+        const Question* q = &questions[i];
+        const TextRef* r = &refs[i * 5];
+        fprintf(out, "    {.id = %lldLL, .question = {%u, %u}, .optionA = {%u, %u}, .optionB = {%u, %u}, "
+                     ".optionC = {%u, %u}, .optionD = {%u, %u}, .correctAnswer = '%c', .difficulty = %d, "
+                     ".irtA = %.9g, .irtB = %.9g, .irtC = %.9g},\n",
+                q->id, r[0].offset, r[0].length, r[1].offset, r[1].length, r[2].offset, r[2].length,
+                r[3].offset, r[3].length, r[4].offset, r[4].length, q->correctAnswer, q->difficulty,
+                q->irtA, q->irtB, q->irtC);
+    }
+    fprintf(out, "};\n\n");
+
+    fprintf(out, "static const unsigned char embeddedDifficulty[] = {");
+    for (int i = 0; i < questionCount; i++) {
+        fprintf(out, "%s%s%d", i ? "," : "", i % 32 ? "" : "\n    ", questionDifficulty[i]);
+    }
+    fprintf(out, "\n};\n");
+    fprintf(out, "static atomic_int embeddedAttempts[%d];\n", questionCount);
+    fprintf(out, "static atomic_int embeddedCorrect[%d];\n\n", questionCount);
+
+    emitIntArray(out, "embeddedEasySlots", difficultySlots[1], difficultySlotCount[1]);
+    emitIntArray(out, "embeddedMediumSlots", difficultySlots[2], difficultySlotCount[2]);
+    emitIntArray(out, "embeddedHardSlots", difficultySlots[3], difficultySlotCount[3]);
+    emitIntArray(out, "embeddedTreeSlots", adaptiveTree.slots, adaptiveTree.size);
+
+    fprintf(out, "\nstatic const IrtEntry embeddedIrtIndex[] = {");
+    for (int i = 0; i < irtIndexSize; i++) {
+        fprintf(out, "%s%s{%.9g, %d}", i ? "," : "", i % 8 ? " " : "\n    ", irtIndex[i].peak, irtIndex[i].slot);
+    }
+    fprintf(out, "\n};\n\n");
+
+    fprintf(out, "static const QuestionIdEntry embeddedIdIndex[] = {");
+    for (int i = 0; i < questionIdCapacity; i++) {
+        fprintf(out, "%s%s{%lldLL, %d}", i ? "," : "", i % 8 ? " " : "\n    ",
+                questionIdIndex[i].slot >= 0 ? questionIdIndex[i].id : 0LL, questionIdIndex[i].slot);
+    }
+    fprintf(out, "\n};\n\n");
+
+    fprintf(out, "static const EmbeddedBank embeddedBank = {\n");
+    fprintf(out, "    embeddedBankText, %u, embeddedQuestions, %d,\n", offset, questionCount);
+    fprintf(out, "    embeddedDifficulty, embeddedAttempts, embeddedCorrect,\n");
+    fprintf(out, "    {NULL, embeddedEasySlots, embeddedMediumSlots, embeddedHardSlots},\n");
+    fprintf(out, "    {0, %d, %d, %d},\n", difficultySlotCount[1], difficultySlotCount[2], difficultySlotCount[3]);
+    fprintf(out, "    embeddedTreeSlots, embeddedIrtIndex, embeddedIdIndex, %d\n", questionIdCapacity);
+    fprintf(out, "};\n");
+
+    free(refs);
+    if (fclose(out) != 0) {
+        printf("Cannot write %s\n", path);
+        return -1;
+    }
+    printf("Wrote %d questions to %s\n", questionCount, path);
+    return 0;
+}
+
+// Points the bank and its indexes at compiled-in tables; O(1)
+void installEmbeddedBank(const EmbeddedBank* bank) {
+    freeBankIndexes();
+    freeQuestionBank();
+
+    bankText = (char*)bank->text;
+    bankTextSize = bank->textSize;
+    questions = (Question*)bank->questions;
+    questionCount = bank->questionCount;
+    questionCapacity = bank->questionCount;
+    questionDifficulty = (unsigned char*)bank->difficulty;
+    questionAttempts = bank->attempts;
+    questionCorrect = bank->correct;
+    questionLatency = (QuestionLatency**)calloc((size_t)bank->questionCount, sizeof(QuestionLatency*));
+    questionIdIndex = (QuestionIdEntry*)bank->idIndex;
+    questionIdCapacity = bank->idCapacity;
+    bankBorrowed = 1;
+
+    for (int d = 1; d <= 3; d++) {
+        difficultySlots[d] = (int*)bank->difficultySlots[d];
+        difficultySlotCount[d] = bank->difficultySlotCount[d];
+        atomic_store(&aggregates.questionCount[d], bank->difficultySlotCount[d]);
+    }
+    adaptiveTree.slots = (int*)bank->treeSlots;
+    adaptiveTree.size = bank->questionCount;
+    irtIndex = (IrtEntry*)bank->irtIndex;
+    irtIndexSize = bank->questionCount;
+    indexesBorrowed = 1;
+
+    bankVersion++;
+    indexedBankVersion = bankVersion;
+}
+
+// Engine Snapshots
+// A snapshot holds the bank, every derived index and all answer statistics
+// in their in-memory layout:
+//   SnapshotHeader, then each SnapshotSection padded to SNAPSHOT_ALIGN
+// Restoring maps the file privately and points the globals into it, so a
+// restart neither parses the bank nor rebuilds the tree; counters updated
+// afterwards only copy the pages they touch. Snapshots are written to a
+// temporary file and renamed into place, and the checksum catches a file
+// that was torn or truncated anyway. Sessions in progress are not saved.
+
+// Identifies the bank a snapshot was taken from by hashing its bytes, so an
+// edit is noticed even when it keeps the file's size and timestamp
+uint64_t bankFingerprint(const char* bankPath) {
+    if (bankPath == NULL) {
+#ifdef EMBEDDED_BANK
+        return snapshotChecksum((const unsigned char*)embeddedBank.text, embeddedBank.textSize);
+#else
+        return 0;
+#endif
+    }
+    size_t size;
+    char* data = mapFile(bankPath, &size);
+    if (data == NULL) return 1;
+    uint64_t fingerprint = snapshotChecksum((const unsigned char*)data, size);
+    unmapFile(data, size);
+    return fingerprint;
+}
+
+// Multiply-xor over 64-bit words in four independent lanes, so it runs at
+// close to memory speed
+uint64_t snapshotChecksum(const unsigned char* data, size_t size) {
+    const uint64_t prime = 0x9E3779B97F4A7C15ULL;
+    uint64_t lane[4] = {1, 2, 3, 4};
+    uint64_t word;
+    size_t i = 0;
+
+    for (; i + 32 <= size; i += 32) {
+        for (int k = 0; k < 4; k++) {
+            memcpy(&word, data + i + 8 * k, sizeof(word));
+            lane[k] = (lane[k] ^ word) * prime;
+        }
+    }
+    for (; i < size; i += 8) {
+        word = 0;
+        memcpy(&word, data + i, size - i < 8 ? size - i : 8);
+        lane[0] = (lane[0] ^ word) * prime;
+    }
+    uint64_t h = (uint64_t)size;
+    for (int k = 0; k < 4; k++) {
+        h = (h ^ lane[k]) * prime;
+        h ^= h >> 29;
+    }
+    return h;
+}
+
+static uint64_t snapshotAlign(uint64_t offset) {
+    return (offset + SNAPSHOT_ALIGN - 1) & ~(uint64_t)(SNAPSHOT_ALIGN - 1);
+}
+
+// Settles the engine and plans a snapshot of it: applies queued answers,
+// re-ranks the slow board and copies everything a lock guards into the
+// header. The big tables are only referenced. Returns -1 without a bank.
+static int planSnapshot(SnapshotPlan* plan, uint64_t fingerprint) {
+    SnapshotHeader* header = &plan->header;
+    const void** source = plan->source;
+    int latencyCount = 0;
+
+    refreshBankIndexes();
+    flushAnswerEvents();
+    if (questionCount == 0) return -1;
+    for (int i = 0; i < questionCount; i++) {
+        if (questionLatency[i] != NULL) latencyCount++;
+    }
+
+    memset(header, 0, sizeof(*header));
+    source[SNAPSHOT_TEXT] = bankText;
+    header->sections[SNAPSHOT_TEXT].size = bankTextSize;
+    source[SNAPSHOT_QUESTIONS] = questions;
+    header->sections[SNAPSHOT_QUESTIONS].size = sizeof(Question) * (uint64_t)questionCount;
+    source[SNAPSHOT_DIFFICULTY] = questionDifficulty;
+    header->sections[SNAPSHOT_DIFFICULTY].size = (uint64_t)questionCount;
+    source[SNAPSHOT_ATTEMPTS] = questionAttempts;
+    header->sections[SNAPSHOT_ATTEMPTS].size = sizeof(atomic_int) * (uint64_t)questionCount;
+    source[SNAPSHOT_CORRECT] = questionCorrect;
+    header->sections[SNAPSHOT_CORRECT].size = sizeof(atomic_int) * (uint64_t)questionCount;
+    for (int d = 1; d <= 3; d++) {
+        source[SNAPSHOT_EASY_SLOTS + d - 1] = difficultySlots[d];
+        header->sections[SNAPSHOT_EASY_SLOTS + d - 1].size = sizeof(int) * (uint64_t)difficultySlotCount[d];
+    }
+    source[SNAPSHOT_TREE] = adaptiveTree.slots;
+    header->sections[SNAPSHOT_TREE].size = sizeof(int) * (uint64_t)adaptiveTree.size;
+    source[SNAPSHOT_IRT_INDEX] = irtIndex;
+    header->sections[SNAPSHOT_IRT_INDEX].size = sizeof(IrtEntry) * (uint64_t)irtIndexSize;
+    source[SNAPSHOT_ID_INDEX] = questionIdIndex;
+    header->sections[SNAPSHOT_ID_INDEX].size = sizeof(QuestionIdEntry) * (uint64_t)questionIdCapacity;
+    source[SNAPSHOT_LATENCY] = NULL;  // gathered from the sparse per-question pointers
+    header->sections[SNAPSHOT_LATENCY].size = sizeof(SnapshotLatency) * (uint64_t)latencyCount;
+
+    uint64_t offset = snapshotAlign(sizeof(*header));
+    for (int k = 0; k < SNAPSHOT_SECTIONS; k++) {
+        header->sections[k].offset = offset;
+        offset = snapshotAlign(offset + header->sections[k].size);
+    }
+
+    memcpy(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic));
+    header->version = SNAPSHOT_VERSION;
+    header->headerSize = sizeof(SnapshotHeader);
+    header->questionSize = sizeof(Question);
+    header->questionCount = questionCount;
+    header->idCapacity = questionIdCapacity;
+    header->fileSize = offset;
+    header->bankFingerprint = fingerprint;
+    header->savedAt = (uint64_t)time(NULL);
+    header->examRecords = atomic_load(&aggregates.examCount);
+    header->scoreSumMilli = atomic_load(&aggregates.scoreSumMilli);
+    for (int d = 1; d <= 3; d++) {
+        header->attempts[d] = atomic_load(&aggregates.attempts[d]);
+        header->correct[d] = atomic_load(&aggregates.correct[d]);
+    }
+    rankSlowQuestions();
+    acquireFlag(&slowQuestions.lock);
+    header->slowCount = slowQuestions.count;
+    for (int k = 0; k < slowQuestions.count; k++) {
+        header->slowSlots[k] = slowQuestions.slots[k];
+        header->slowMedianNs[k] = slowQuestions.medianNs[k];
+        header->slowMeanNs[k] = slowQuestions.meanNs[k];
+    }
+    releaseFlag(&slowQuestions.lock);
+    memcpy(header->difficultyLatency, difficultyLatency, sizeof(difficultyLatency));
+    return 0;
+}
+
+// Lays a planned snapshot out in image (header.fileSize zeroed bytes) and
+// stamps the checksum. It only reads memory, so a forked writer can run it.
+static void fillSnapshotImage(const SnapshotPlan* plan, unsigned char* image) {
+    const SnapshotHeader* header = &plan->header;
+    for (int k = 0; k < SNAPSHOT_SECTIONS; k++) {
+        if (plan->source[k] != NULL && header->sections[k].size > 0) {
+            memcpy(image + header->sections[k].offset, plan->source[k], (size_t)header->sections[k].size);
+        }
+    }
+    SnapshotLatency* latency = (SnapshotLatency*)(image + header->sections[SNAPSHOT_LATENCY].offset);
+    for (int i = 0; i < header->questionCount; i++) {
+        if (questionLatency[i] == NULL) continue;
+        latency->slot = i;
+        latency->latency = *questionLatency[i];
+        latency++;
+    }
+    memcpy(image, header, sizeof(*header));
+
+    size_t covered = offsetof(SnapshotHeader, checksum) + sizeof(header->checksum);
+    uint64_t checksum = snapshotChecksum(image + covered, (size_t)header->fileSize - covered);
+    memcpy(image + offsetof(SnapshotHeader, checksum), &checksum, sizeof(checksum));
+}
+
+// Writes the image beside path and renames it into place, so a crash leaves
+// one complete snapshot or the other. Plain system calls only, no stdio;
+// returns 0 or the errno of the step that failed.
+static int saveSnapshotImage(const char* path, const unsigned char* image, size_t size) {
+    char tempPath[1024];
+    size_t length = strlen(path);
+    if (length + sizeof(".tmp") > sizeof(tempPath)) return ENAMETOOLONG;
+    memcpy(tempPath, path, length);
+    memcpy(tempPath + length, ".tmp", sizeof(".tmp"));
+
+    int fd = open(tempPath, SNAPSHOT_OPEN_FLAGS, 0644);
+    if (fd < 0) return errno;
+    int error = 0;
+    while (size > 0 && error == 0) {
+        ssize_t written = write(fd, image, size);
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) {
+            error = written < 0 ? errno : EIO;
+        } else {
+            image += written;
+            size -= (size_t)written;
+        }
+    }
+    if (error == 0 && fsync(fd) != 0) error = errno;
+    if (close(fd) != 0 && error == 0) error = errno;
+#ifdef _WIN32
+    if (error == 0) remove(path);
+#endif
+    if (error == 0 && rename(tempPath, path) != 0) error = errno;
+    if (error != 0) unlink(tempPath);
+    return error;
+}
+
+int writeSnapshot(const char* path, uint64_t fingerprint) {
+    SnapshotPlan plan;
+    if (planSnapshot(&plan, fingerprint) != 0) return -1;
+    unsigned char* image = (unsigned char*)calloc(1, (size_t)plan.header.fileSize);
+    if (image == NULL) {
+        printf("Out of memory for the snapshot!\n");
+        return -1;
+    }
+    fillSnapshotImage(&plan, image);
+    int error = saveSnapshotImage(path, image, (size_t)plan.header.fileSize);
+    free(image);
+    if (error != 0) {
+        printf("Cannot write snapshot %s: %s\n", path, strerror(error));
+        return -1;
+    }
+    snapshotWrittenAt = time(NULL);
+    return 0;
+}
+
+#ifndef _WIN32
+// Collects the snapshot writer once it is done (options as for waitpid)
+// and reports a failed write; returns 0 while it is still writing
+static int reapSnapshotWriter(int options) {
+    int status = 0;
+    pid_t done;
+    while ((done = waitpid(snapshotWriter, &status, options)) < 0 && errno == EINTR) { }
+    if (done == 0) return 0;
+    if (done > 0 && WIFEXITED(status) && WEXITSTATUS(status) != 0) {
+        printf("Cannot write snapshot %s: %s\n", snapshotPath, strerror(WEXITSTATUS(status)));
+    } else if (done > 0 && !WIFEXITED(status)) {
+        printf("Cannot write snapshot %s: the writer was stopped\n", snapshotPath);
+    }
+    snapshotWriter = 0;
+    return 1;
+}
+#endif
+
+// Starts a periodic snapshot when one is configured and the last is old
+// enough. Called between requests by the server loop and the console menu,
+// never from the exam engine. The plan, with everything behind a lock, is
+// settled here; a forked child then fills and writes the image from its
+// copy-on-write view of the tables, so the caller only pays for the fork.
+void maybeWriteSnapshot(void) {
+    if (snapshotPath == NULL) return;
+#ifndef _WIN32
+    if (snapshotWriter > 0 && !reapSnapshotWriter(WNOHANG)) return;
+#endif
+    if (time(NULL) - snapshotWrittenAt < SNAPSHOT_INTERVAL_SECONDS) return;
+    long long exams = atomic_load(&aggregates.examCount);
+    if (exams == snapshotExams) return;  // no exam finished since the last one
+    snapshotExams = exams;
+#ifdef _WIN32
+    writeSnapshot(snapshotPath, snapshotFingerprint);
+#else
+    SnapshotPlan plan;
+    if (planSnapshot(&plan, snapshotFingerprint) != 0) return;
+    // Untouched zero pages are free, so the child pays for filling them
+    unsigned char* image = (unsigned char*)calloc(1, (size_t)plan.header.fileSize);
+    if (image == NULL) {
+        printf("Out of memory for the snapshot!\n");
+        return;
+    }
+    fflush(stdout);
+    pid_t child = fork();
+    if (child == 0) {
+        // The aggregator thread, its locks and stdio stay with the parent:
+        // only memory reads and system calls from here on
+        fillSnapshotImage(&plan, image);
+        _exit(saveSnapshotImage(snapshotPath, image, (size_t)plan.header.fileSize));
+    }
+    free(image);
+    if (child < 0) {
+        printf("Cannot start the snapshot writer: %s\n", strerror(errno));
+    } else {
+        snapshotWriter = child;
+    }
+    snapshotWrittenAt = time(NULL);  // the child cannot update ours
+#endif
+}
+
+// Waits for a periodic snapshot still being written, so a final snapshot
+// does not race it for the same file
+void waitSnapshotWriter(void) {
+#ifndef _WIN32
+    if (snapshotWriter > 0) reapSnapshotWriter(0);
+#endif
+}
+
+static int snapshotSectionFits(const SnapshotHeader* header, int section, uint64_t expectedSize) {
+    const SnapshotSection* s = &header->sections[section];
+    return s->offset % SNAPSHOT_ALIGN == 0 && s->offset >= header->headerSize &&
+           s->offset <= header->fileSize && s->size <= header->fileSize - s->offset &&
+           s->size == expectedSize;
+}
+
+// Replaces the bank, its indexes and the statistics with a snapshot.
+// Returns -1 and leaves everything untouched when there is no usable snapshot
+// for the bank with this fingerprint.
+int restoreSnapshot(const char* path, uint64_t fingerprint) {
+    size_t size;
+    char* data = mapFileWritable(path, &size);
+    if (data == NULL) return -1;
+
+    const SnapshotHeader* header = (const SnapshotHeader*)data;
+    const char* problem = NULL;
+    size_t covered = offsetof(SnapshotHeader, checksum) + sizeof(header->checksum);
+    if (size < sizeof(SnapshotHeader) || memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) != 0) {
+        problem = "not a snapshot";
+    } else if (header->version != SNAPSHOT_VERSION || header->headerSize != sizeof(SnapshotHeader) ||
+               header->questionSize != sizeof(Question)) {
+        problem = "unsupported version";
+    } else if (header->fileSize != size ||
+               header->checksum != snapshotChecksum((const unsigned char*)data + covered, size - covered)) {
+        problem = "checksum mismatch, the file is torn or truncated";
+    } else if (header->bankFingerprint != fingerprint) {
+        problem = "taken from a different question bank";
+    }
+
+    if (problem == NULL) {
+        uint64_t n = (uint64_t)(header->questionCount > 0 ? header->questionCount : 0);
+        const SnapshotSection* sections = header->sections;
+        uint64_t slotTotal = 0;
+        int fits = n > 0 && header->idCapacity > 0 &&
+                   (header->idCapacity & (header->idCapacity - 1)) == 0 &&
+                   header->slowCount >= 0 && header->slowCount <= SLOWEST_QUESTIONS_SHOWN &&
+                   snapshotSectionFits(header, SNAPSHOT_TEXT, sections[SNAPSHOT_TEXT].size) &&
+                   snapshotSectionFits(header, SNAPSHOT_QUESTIONS, sizeof(Question) * n) &&
+                   snapshotSectionFits(header, SNAPSHOT_DIFFICULTY, n) &&
+                   snapshotSectionFits(header, SNAPSHOT_ATTEMPTS, sizeof(atomic_int) * n) &&
+                   snapshotSectionFits(header, SNAPSHOT_CORRECT, sizeof(atomic_int) * n) &&
+                   snapshotSectionFits(header, SNAPSHOT_TREE, sizeof(int) * n) &&
+                   snapshotSectionFits(header, SNAPSHOT_IRT_INDEX, sizeof(IrtEntry) * n) &&
+                   snapshotSectionFits(header, SNAPSHOT_ID_INDEX,
+                                       sizeof(QuestionIdEntry) * (uint64_t)header->idCapacity) &&
+                   snapshotSectionFits(header, SNAPSHOT_LATENCY, sections[SNAPSHOT_LATENCY].size) &&
+                   sections[SNAPSHOT_LATENCY].size % sizeof(SnapshotLatency) == 0;
+        for (int d = 0; d < 3; d++) {
+            fits = fits && snapshotSectionFits(header, SNAPSHOT_EASY_SLOTS + d, sections[SNAPSHOT_EASY_SLOTS + d].size);
+            slotTotal += sections[SNAPSHOT_EASY_SLOTS + d].size / sizeof(int);
+        }
+        if (!fits || slotTotal != n) problem = "inconsistent section table";
+    }
+    if (problem != NULL) {
+        printf("Ignoring snapshot %s: %s\n", path, problem);
+        unmapFile(data, size);
+        return -1;
+    }
+
+    freeBankIndexes();
+    freeQuestionBank();
+
+    const SnapshotSection* sections = header->sections;
+    int n = header->questionCount;
+    bankText = data + sections[SNAPSHOT_TEXT].offset;
+    bankTextSize = (size_t)sections[SNAPSHOT_TEXT].size;
+    questions = (Question*)(data + sections[SNAPSHOT_QUESTIONS].offset);
+    questionCount = n;
+    questionCapacity = n;
+    questionDifficulty = (unsigned char*)(data + sections[SNAPSHOT_DIFFICULTY].offset);
+    questionAttempts = (atomic_int*)(data + sections[SNAPSHOT_ATTEMPTS].offset);
+    questionCorrect = (atomic_int*)(data + sections[SNAPSHOT_CORRECT].offset);
+    questionIdIndex = (QuestionIdEntry*)(data + sections[SNAPSHOT_ID_INDEX].offset);
+    questionIdCapacity = header->idCapacity;
+    questionLatency = (QuestionLatency**)calloc((size_t)n, sizeof(QuestionLatency*));
+    const SnapshotLatency* latency = (const SnapshotLatency*)(data + sections[SNAPSHOT_LATENCY].offset);
+    size_t latencyCount = (size_t)(sections[SNAPSHOT_LATENCY].size / sizeof(SnapshotLatency));
+    for (size_t i = 0; i < latencyCount; i++) {
+        int slot = latency[i].slot;
+        if (slot < 0 || slot >= n || questionLatency[slot] != NULL) continue;
+        questionLatency[slot] = (QuestionLatency*)malloc(sizeof(QuestionLatency));
+        if (questionLatency[slot] != NULL) *questionLatency[slot] = latency[i].latency;
+    }
+    snapshotMapping = data;
+    snapshotSize = size;
+    bankBorrowed = 1;
+
+    for (int d = 1; d <= 3; d++) {
+        difficultySlots[d] = (int*)(data + sections[SNAPSHOT_EASY_SLOTS + d - 1].offset);
+        difficultySlotCount[d] = (int)(sections[SNAPSHOT_EASY_SLOTS + d - 1].size / sizeof(int));
+        atomic_store(&aggregates.questionCount[d], difficultySlotCount[d]);
+        atomic_store(&aggregates.attempts[d], (long)header->attempts[d]);
+        atomic_store(&aggregates.correct[d], (long)header->correct[d]);
+    }
+    adaptiveTree.slots = (int*)(data + sections[SNAPSHOT_TREE].offset);
+    adaptiveTree.size = n;
+    irtIndex = (IrtEntry*)(data + sections[SNAPSHOT_IRT_INDEX].offset);
+    irtIndexSize = n;
+    indexesBorrowed = 1;
+
+    atomic_store(&aggregates.examCount, header->examRecords);
+    atomic_store(&aggregates.scoreSumMilli, header->scoreSumMilli);
+    snapshotExamRecords = header->examRecords;
+    acquireFlag(&slowQuestions.lock);
+    slowQuestions.count = header->slowCount;
+    for (int k = 0; k < header->slowCount; k++) {
+        slowQuestions.slots[k] = header->slowSlots[k];
+        slowQuestions.medianNs[k] = header->slowMedianNs[k];
+        slowQuestions.meanNs[k] = header->slowMeanNs[k];
+    }
+    releaseFlag(&slowQuestions.lock);
+    memcpy(difficultyLatency, header->difficultyLatency, sizeof(difficultyLatency));
+
+    bankVersion++;
+    indexedBankVersion = bankVersion;
+    return 0;
+}
+
+// Rendered Questions
+// Every question is formatted once per bank version, for the console and
+// for the server protocol, into one arena. Showing a question is then a
+// single write of a ready block, and the server copies the block into the
+// connection's output buffer. The blocks are built on first use rather than
+// at load, so restoring a snapshot or an embedded bank stays instant; the
+// server builds them before it accepts connections.
+static void renderAppend(char** arena, size_t* size, size_t* capacity, const char* data, size_t length) {
+    if (*size + length > *capacity) {
+        size_t newCapacity = *capacity ? *capacity : 4096;
+        while (newCapacity < *size + length) newCapacity *= 2;
+        char* grown = (char*)realloc(*arena, newCapacity);
+        if (grown == NULL) {
+            printf("Out of memory rendering questions!\n");
+            exit(1);
+        }
+        *arena = grown;
+        *capacity = newCapacity;
+    }
+    memcpy(*arena + *size, data, length);
+    *size += length;
+}
+
+static void renderField(char** arena, size_t* size, size_t* capacity, const char* prefix, TextRef field,
+                        const char* suffix) {
+    renderAppend(arena, size, capacity, prefix, strlen(prefix));
+    renderAppend(arena, size, capacity, textOf(field), field.length);
+    renderAppend(arena, size, capacity, suffix, strlen(suffix));
+}
+
+// Builds the blocks unless they are current; no-op for an unchanged bank
+void renderQuestions(void) {
+    static const char rule[] = "---------------------------------------\n";
+    char line[96];
+    if (renderedVersion == bankVersion) return;
+    freeRenderedQuestions();
+
+    size_t size = 0;
+    size_t capacity = bankTextSize * 2 + (size_t)questionCount * 160;
+    char* arena = (char*)malloc(capacity > 0 ? capacity : 1);
+    size_t* offsets = (size_t*)malloc(sizeof(size_t) * (2 * (size_t)questionCount + 1));
+    if (arena == NULL || offsets == NULL) {
+        printf("Out of memory rendering questions!\n");
+        exit(1);
+    }
+    for (int i = 0; i < questionCount; i++) {
+        const Question* q = &questions[i];
+        offsets[2 * i] = size;
+        int length = snprintf(line, sizeof(line), "\n%sQuestion ID: %lld\nDifficulty: %s\n", rule, q->id,
+                              q->difficulty == 1 ? "Easy" : q->difficulty == 2 ? "Medium" : "Hard");
+        renderAppend(&arena, &size, &capacity, line, (size_t)length);
+        renderField(&arena, &size, &capacity, "\n", q->question, "\n");
+        renderField(&arena, &size, &capacity, "A) ", q->optionA, "\n");
+        renderField(&arena, &size, &capacity, "B) ", q->optionB, "\n");
+        renderField(&arena, &size, &capacity, "C) ", q->optionC, "\n");
+        renderField(&arena, &size, &capacity, "D) ", q->optionD, "\n");
+        renderAppend(&arena, &size, &capacity, rule, sizeof(rule) - 1);
+
+        offsets[2 * i + 1] = size;
+        length = snprintf(line, sizeof(line), "QUESTION\t%lld\t%d", q->id, q->difficulty);
+        renderAppend(&arena, &size, &capacity, line, (size_t)length);
+        renderField(&arena, &size, &capacity, "\t", q->question, "");
+        renderField(&arena, &size, &capacity, "\t", q->optionA, "");
+        renderField(&arena, &size, &capacity, "\t", q->optionB, "");
+        renderField(&arena, &size, &capacity, "\t", q->optionC, "");
+        renderField(&arena, &size, &capacity, "\t", q->optionD, "\n");
+    }
+    offsets[2 * (size_t)questionCount] = size;
+
+    renderedText = arena;
+    renderedOffset = offsets;
+    renderedVersion = bankVersion;
+}
+
+void freeRenderedQuestions(void) {
+    free(renderedText);
+    free(renderedOffset);
+    renderedText = NULL;
+    renderedOffset = NULL;
+    renderedVersion = 0;
+}
+
+const char* renderedQuestion(int slot, RenderKind kind, size_t* length) {
+    renderQuestions();
+    size_t index = 2 * (size_t)slot + kind;
+    *length = renderedOffset[index + 1] - renderedOffset[index];
+    return renderedText + renderedOffset[index];
+}
+
+// Writes straight to standard output in as few system calls as possible
+void writeOutput(const char* data, size_t length) {
+    fflush(stdout);
+    while (length > 0) {
+        ssize_t written = write(fileno(stdout), data, length);
+        if (written <= 0) break;
+        data += written;
+        length -= (size_t)written;
+    }
+}
+
+void outputAppend(OutputBuffer* out, const char* data, size_t length) {
+    if (out->length + length > sizeof(out->data)) {
+        writeOutput(out->data, out->length);
+        out->length = 0;
+        if (length > sizeof(out->data)) {
+            writeOutput(data, length);
+            return;
+        }
+    }
+    memcpy(out->data + out->length, data, length);
+    out->length += length;
+}
+
+void outputFlush(OutputBuffer* out) {
+    writeOutput(out->data, out->length);
+    out->length = 0;
+}
+
+void displayQuestion(Question* q) {
+    size_t length;
+    const char* block = renderedQuestion((int)(q - questions), RENDER_CONSOLE, &length);
+    writeOutput(block, length);
+}
+
+// Performance Tracking
+// Grades an answer for the session; returns 1 when it was correct
+int trackAnswer(ExamSession* s, Question* q, char userAnswer, uint64_t timeNs) {
+    if (s->performanceCount >= MAX_EXAM_QUESTIONS) {
+        return 0;
+    }
+
+    Performance* p = &s->performances[s->performanceCount];
+    p->questionId = q->id;
+    p->userAnswer = toupper((unsigned char)userAnswer);
+    p->correctAnswer = q->correctAnswer;
+    p->isCorrect = (p->userAnswer == q->correctAnswer);
+    p->timeSpentNs = timeNs;
+
+    // Bank-wide statistics are the aggregator's job
+    AnswerEvent event = {(int)(q - questions), p->isCorrect, timeNs};
+    publishAnswerEvent(&event);
+
+    updateStats(&s->stats, p->isCorrect, q->difficulty, timeNs);
+    s->performanceCount++;
+    return p->isCorrect;
+}
+
+// Prints the summary of a finished exam and stores it in the history
+void evaluateResults(ExamSession* s) {
+    const ExamStats* stats = &s->stats;
+    printf("\n\n===========================================\n");
+    printf("          EXAM RESULTS SUMMARY\n");
+    printf("===========================================\n");
+    printf("Total Questions: %d\n", stats->totalQuestions);
+    printf("Correct Answers: %d\n", stats->correctAnswers);
+    printf("Wrong Answers: %d\n", stats->wrongAnswers);
+    printf("Skipped Questions: %d\n", stats->skippedQuestions);
+    if (stats->totalQuestions > 0) {
+        printf("Average Score: %.2f%%\n",
+               (float)stats->correctAnswers / stats->totalQuestions * 100.0f);
+    } else {
+        printf("Average Score: N/A\n");
+    }
+    printf("Average Difficulty: %.2f\n", stats->averageDifficulty);
+    if (s->mode == EXAM_MODE_IRT) {
+        printf("Ability Estimate: %.2f (standard error %.2f)\n", s->theta, s->thetaSE);
+    }
+    printf("Time Taken: %.1f s\n", stats->timeTakenNs / 1e9);
+    if (s->timeouts > 0) {
+        printf("Questions Timed Out: %d\n", s->timeouts);
+    }
+    if (s->examDeadlineNs != 0 && monotonicNs() >= s->examDeadlineNs && s->askedCount < s->numQuestions) {
+        printf("Exam time limit reached after %d of %d questions\n", s->askedCount, s->numQuestions);
+    }
+    printf("===========================================\n");
+
+    finishSession(s);
+}
+
+void displayResults(const ExamSession* s) {
+    int i;
+    printf("\n\n===========================================\n");
+    printf("          DETAILED RESULTS\n");
+    printf("===========================================\n");
+
+    for (i = 0; i < s->performanceCount; i++) {
+        printf("Question %lld: ", s->performances[i].questionId);
+        printf("Your answer: %c, ", s->performances[i].userAnswer);
+        printf("Correct: %c, ", s->performances[i].correctAnswer);
+        printf("Time: %.1f s, ", s->performances[i].timeSpentNs / 1e9);
+        printf("Status: %s\n", s->performances[i].isCorrect ? "CORRECT" : "WRONG");
+    }
+}
+
+// Statistics Management
+void resetStats(ExamSession* s) {
+    s->stats.totalQuestions = 0;
+    s->stats.correctAnswers = 0;
+    s->stats.wrongAnswers = 0;
+    s->stats.skippedQuestions = 0;
+    s->stats.averageDifficulty = 0.0f;
+    s->stats.timeTakenNs = 0;
+    s->performanceCount = 0;
+    s->responseCount = 0;
+}
+
+void updateStats(ExamStats* stats, int isCorrect, int difficulty, uint64_t timeNs) {
+    stats->totalQuestions++;
+    stats->timeTakenNs += timeNs;
+
+    if (isCorrect) {
+        stats->correctAnswers++;
+    } else {
+        stats->wrongAnswers++;
+    }
+
+    // Update average difficulty incrementally
+    stats->averageDifficulty =
+        ((stats->averageDifficulty * (stats->totalQuestions - 1)) + difficulty) /
+        stats->totalQuestions;
+}
+
+// Stores a finished exam in the history
+void recordExamResult(const ExamStats* stats) {
+    appendExamRecord(stats);
+}
+
+// Report Aggregates
+void countBankQuestion(int difficulty) {
+    if (difficulty < 1 || difficulty > 3) return;
+    atomic_fetch_add_explicit(&aggregates.questionCount[difficulty], 1, memory_order_relaxed);
+}
+
+// Forgets everything tied to the current bank; exam totals belong to the
+// history log and survive bank reloads
+void resetBankAggregates(void) {
+    for (int d = 0; d < 4; d++) {
+        atomic_store_explicit(&aggregates.questionCount[d], 0, memory_order_relaxed);
+        atomic_store_explicit(&aggregates.attempts[d], 0, memory_order_relaxed);
+        atomic_store_explicit(&aggregates.correct[d], 0, memory_order_relaxed);
+    }
+    acquireFlag(&slowQuestions.lock);
+    slowQuestions.count = 0;
+    slowQuestions.stale = 0;
+    releaseFlag(&slowQuestions.lock);
+}
+
+void countExam(float score) {
+    atomic_fetch_add_explicit(&aggregates.examCount, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&aggregates.scoreSumMilli, (long long)(score * 1000.0f + 0.5f),
+                              memory_order_relaxed);
+}
+
+// Inserts a question into the board in rank order, if it makes the cut
+static void insertSlowQuestion(SlowQuestionBoard* b, int slot, uint64_t median, uint64_t mean) {
+    int k = 0;
+    while (k < b->count && (b->medianNs[k] > median ||
+                            (b->medianNs[k] == median && b->meanNs[k] >= mean))) {
+        k++;
+    }
+    if (k < SLOWEST_QUESTIONS_SHOWN) {
+        int tail = (b->count < SLOWEST_QUESTIONS_SHOWN ? b->count : SLOWEST_QUESTIONS_SHOWN - 1) - k;
+        memmove(&b->slots[k + 1], &b->slots[k], sizeof(b->slots[0]) * tail);
+        memmove(&b->medianNs[k + 1], &b->medianNs[k], sizeof(b->medianNs[0]) * tail);
+        memmove(&b->meanNs[k + 1], &b->meanNs[k], sizeof(b->meanNs[0]) * tail);
+        b->slots[k] = slot;
+        b->medianNs[k] = median;
+        b->meanNs[k] = mean;
+        if (b->count < SLOWEST_QUESTIONS_SHOWN) b->count++;
+    }
+}
+
+// Re-ranks one question on the slow board after it was answered; costs
+// O(SLOWEST_QUESTIONS_SHOWN) whatever the bank size
+void updateSlowQuestions(const Question* q) {
+    int slot = (int)(q - questions);
+    const QuestionLatency* latency = questionLatency[slot];
+    if (latency == NULL || latency->count == 0) return;
+    uint64_t median = questionLatencyMedian(q);
+    uint64_t mean = latency->totalNs / latency->count;
+
+    acquireFlag(&slowQuestions.lock);
+    SlowQuestionBoard* b = &slowQuestions;
+    for (int k = 0; k < b->count; k++) {
+        if (b->slots[k] != slot) continue;
+        if (median < b->medianNs[k] || (median == b->medianNs[k] && mean < b->meanNs[k])) {
+            b->stale = 1;
+        }
+        int tail = b->count - k - 1;
+        memmove(&b->slots[k], &b->slots[k + 1], sizeof(b->slots[0]) * tail);
+        memmove(&b->medianNs[k], &b->medianNs[k + 1], sizeof(b->medianNs[0]) * tail);
+        memmove(&b->meanNs[k], &b->meanNs[k + 1], sizeof(b->meanNs[0]) * tail);
+        b->count--;
+        break;
+    }
+    insertSlowQuestion(b, slot, median, mean);
+    releaseFlag(&slowQuestions.lock);
+}
+
+// Rebuilds a stale board from every question's histogram (one pass over the
+// answered questions); does nothing while the board is exact
+void rankSlowQuestions(void) {
+    acquireFlag(&slowQuestions.lock);
+    SlowQuestionBoard* b = &slowQuestions;
+    if (b->stale) {
+        b->count = 0;
+        for (int i = 0; i < questionCount; i++) {
+            const QuestionLatency* latency = questionLatency[i];
+            if (latency == NULL || latency->count == 0) continue;
+            insertSlowQuestion(b, i, questionLatencyMedian(&questions[i]), latency->totalNs / latency->count);
+        }
+        b->stale = 0;
+    }
+    releaseFlag(&slowQuestions.lock);
+}
+
+// Helpers for adaptive logic
+// Walks down the tree towards the preferred difficulty: harder is left,
+// easier is right. Returns -1 when no question has that difficulty.
+int findStartNode(const AdaptiveTree* tree, int preferredDifficulty) {
+    int node = tree->size > 0 ? 0 : -1;
+    while (node >= 0) {
+        int difficulty = treeQuestion(tree, node)->difficulty;
+        if (difficulty == preferredDifficulty) return node;
+        node = difficulty < preferredDifficulty ? treeLeft(tree, node) : treeRight(tree, node);
+    }
+    return -1;
+}
+
+Question* getNextUnaskedQuestion(int difficulty, AskedSet* asked) {
+    if (difficulty < 1 || difficulty > 3) return NULL;
+    int* slots = difficultySlots[difficulty];
+    int* cursor = &asked->difficultyCursor[difficulty];
+    while (*cursor < difficultySlotCount[difficulty] && isAsked(asked, slots[*cursor])) {
+        (*cursor)++;
+    }
+    if (*cursor == difficultySlotCount[difficulty]) return NULL;
+    return &questions[slots[*cursor]];
+}
+
+// Tree-mode pick: the current node's question while it is unasked, else the
+// next unasked question of the node's difficulty (medium off the tree), else any
+Question* pickTreeQuestion(int currentNode, AskedSet* asked) {
+    if (currentNode >= 0 && !isAsked(asked, adaptiveTree.slots[currentNode])) {
+        return treeQuestion(&adaptiveTree, currentNode);
+    }
+    int targetDiff = 2;
+    if (currentNode >= 0) targetDiff = treeQuestion(&adaptiveTree, currentNode)->difficulty;
+    Question* q = getNextUnaskedQuestion(targetDiff, asked);
+    if (q == NULL) q = getAnyUnaskedQuestion(asked);
+    return q;
+}
+
+// Tree node after answering the question picked at currentNode (called
+// before that question is marked asked). Correct moves to the easier child,
+// wrong to the harder one, a skip stays put; -1 falls back to direct picks.
+int nextTreeNode(int currentNode, AnswerResult result, const AskedSet* asked) {
+    if (result == ANSWER_SKIPPED) return currentNode;
+    int next = result == ANSWER_CORRECT ? treeRight(&adaptiveTree, currentNode)
+                                        : treeLeft(&adaptiveTree, currentNode);
+    return next >= 0 && !isAsked(asked, adaptiveTree.slots[next]) ? next : -1;
+}
+
+Question* getAnyUnaskedQuestion(AskedSet* asked) {
+    int word = asked->anyCursor / 64;
+    if (word >= asked->wordCount) return NULL;
+
+    // Skip whole words of asked questions, then take the lowest clear bit
+    uint64_t freeBits = ~asked->bits[word] & (~0ULL << (asked->anyCursor % 64));
+    while (freeBits == 0) {
+        if (++word == asked->wordCount) {
+            asked->anyCursor = questionCount;
+            return NULL;
+        }
+        freeBits = ~asked->bits[word];
+    }
+    int slot = word * 64 + __builtin_ctzll(freeBits);
+    if (slot >= questionCount) {
+        asked->anyCursor = questionCount;
+        return NULL;
+    }
+    asked->anyCursor = slot;
+    return &questions[slot];
+}
+
+// Availability Index
+// Groups bank slots by difficulty; rebuilt whenever the bank is (re)loaded.
+void buildDifficultyIndex(void) {
+    int d;
+    freeDifficultyIndex();
+    for (int i = 0; i < questionCount; i++) {
+        d = questionDifficulty[i];
+        if (d >= 1 && d <= 3) difficultySlotCount[d]++;
+    }
+    for (d = 1; d <= 3; d++) {
+        difficultySlots[d] = (int*)malloc(sizeof(int) * (difficultySlotCount[d] > 0 ? difficultySlotCount[d] : 1));
+        difficultySlotCount[d] = 0;
+    }
+    for (int i = 0; i < questionCount; i++) {
+        d = questionDifficulty[i];
+        if (d >= 1 && d <= 3) difficultySlots[d][difficultySlotCount[d]++] = i;
+    }
+}
+
+void freeDifficultyIndex(void) {
+    for (int d = 0; d < 4; d++) {
+        free(difficultySlots[d]);
+        difficultySlots[d] = NULL;
+        difficultySlotCount[d] = 0;
+    }
+}
+
+int initAskedSet(AskedSet* asked, int slotCount) {
+    memset(asked, 0, sizeof(*asked));
+    asked->wordCount = (slotCount + 63) / 64;
+    asked->bits = (uint64_t*)calloc(asked->wordCount > 0 ? asked->wordCount : 1, sizeof(uint64_t));
+    return asked->bits != NULL ? 0 : -1;
+}
+
+void freeAskedSet(AskedSet* asked) {
+    free(asked->bits);
+    free(asked->marked);
+    memset(asked, 0, sizeof(*asked));
+}
+
+// Unmarks only the slots marked since the last clear
+void clearAskedSet(AskedSet* asked) {
+    for (int i = 0; i < asked->markedCount; i++) {
+        int slot = asked->marked[i];
+        asked->bits[slot / 64] &= ~(1ULL << (slot % 64));
+    }
+    asked->markedCount = 0;
+    asked->anyCursor = 0;
+    memset(asked->difficultyCursor, 0, sizeof(asked->difficultyCursor));
+}
+
+// Returns -1, leaving the slot unmarked, when the marked list cannot grow
+int markAsked(AskedSet* asked, int slot) {
+    if (isAsked(asked, slot)) return 0;
+    if (asked->markedCount == asked->markedCapacity) {
+        int newCapacity = asked->markedCapacity ? asked->markedCapacity * 2 : 16;
+        int* marked = (int*)realloc(asked->marked, sizeof(int) * newCapacity);
+        if (marked == NULL) return -1;
+        asked->marked = marked;
+        asked->markedCapacity = newCapacity;
+    }
+    asked->marked[asked->markedCount++] = slot;
+    asked->bits[slot / 64] |= 1ULL << (slot % 64);
+    return 0;
+}
+
+int isAsked(const AskedSet* asked, int slot) {
+    return (asked->bits[slot / 64] >> (slot % 64)) & 1;
+}
+
+// Keyword Search
+// An inverted index over the question and option text. The console and the
+// server build it once the bank is loaded; the batch modes never search, so
+// they skip it. Any change to the bank drops it with the other derived
+// indexes and the next search rebuilds it. Words are runs of
+// letters and digits (bytes above 0x7F count as letters, so UTF-8 words stay
+// whole), lowercased and cut to SEARCH_TERM_MAX bytes. Each term keeps the
+// slots containing it in ascending order, delta-encoded as varints in
+// blocks of SEARCH_BLOCK_POSTINGS; a skip entry per block holds its first
+// slot and byte offset. A query intersects the lists of its words, rarest
+// first, and jumps over whole blocks that cannot match.
+
+// Lowercased form of each byte that belongs to a word, 0 for separators
+static unsigned char searchFold[256];
+
+static void initSearchFold(void) {
+    for (int c = 0; c < 256; c++) {
+        searchFold[c] = (unsigned char)(c >= 0x80 || isalnum(c) ? tolower(c) : 0);
+    }
+}
+
+static uint64_t hashSearchTerm(const char* term, int length) {
+    uint64_t h = 1469598103934665603ULL;
+    for (int i = 0; i < length; i++) h = (h ^ (unsigned char)term[i]) * 1099511628211ULL;
+    return h;
+}
+
+// Finds the next word at or after *p; returns its length (0 when there is
+// none), copies it lowercased into term and hashes it on the way
+static int nextSearchTerm(const char** p, const char* end, char* term, uint64_t* hash) {
+    const unsigned char* s = (const unsigned char*)*p;
+    const unsigned char* e = (const unsigned char*)end;
+    uint64_t h = 1469598103934665603ULL;
+    while (s < e && searchFold[*s] == 0) s++;
+    int length = 0;
+    while (s < e && searchFold[*s] != 0) {
+        if (length < SEARCH_TERM_MAX) {
+            term[length++] = (char)searchFold[*s];
+            h = (h ^ searchFold[*s]) * 1099511628211ULL;
+        }
+        s++;
+    }
+    *p = (const char*)s;
+    *hash = h;
+    return length;
+}
+
+// Probes the term table; returns the slot holding the term, or the empty
+// slot where it would go. The upper hash bits are kept in each entry, so
+// the term text is only compared on a likely match.
+static uint64_t probeSearchTerm(const char* term, int length, uint64_t hash) {
+    uint64_t mask = (uint64_t)searchIndex.tableCapacity - 1;
+    uint64_t tag = hash >> 32;
+    uint64_t i = hash & mask;
+    for (; searchIndex.table[i] != 0; i = (i + 1) & mask) {
+        uint64_t entry = searchIndex.table[i];
+        if (entry >> 32 != tag) continue;
+        const SearchTerm* t = &searchIndex.terms[(uint32_t)entry - 1];
+        if (t->length == length && memcmp(searchIndex.termText + t->textOffset, term, length) == 0) break;
+    }
+    return i;
+}
+
+// Returns the index of a term, or -1 when no question contains it
+static int findSearchTerm(const char* term, int length, uint64_t hash) {
+    if (searchIndex.tableCapacity == 0) return -1;
+    uint64_t entry = searchIndex.table[probeSearchTerm(term, length, hash)];
+    return entry != 0 ? (int)(uint32_t)entry - 1 : -1;
+}
+
+// Returns the index of the term, adding it if needed; -1 when out of memory
+static int insertSearchTerm(const char* term, int length, uint64_t hash) {
+    if (searchIndex.tableCapacity > 0) {
+        uint64_t entry = searchIndex.table[probeSearchTerm(term, length, hash)];
+        if (entry != 0) return (int)(uint32_t)entry - 1;
+    }
+
+    if ((size_t)(searchIndex.termCount + 1) * 2 > searchIndex.tableCapacity) {
+        size_t capacity = searchIndex.tableCapacity ? searchIndex.tableCapacity * 2 : 4096;
+        uint64_t* table = (uint64_t*)calloc(capacity, sizeof(uint64_t));
+        if (table == NULL) return -1;
+        for (size_t i = 0; i < searchIndex.tableCapacity; i++) {
+            uint64_t entry = searchIndex.table[i];
+            if (entry == 0) continue;
+            const SearchTerm* old = &searchIndex.terms[(uint32_t)entry - 1];
+            uint64_t j = hashSearchTerm(searchIndex.termText + old->textOffset, old->length) & (uint64_t)(capacity - 1);
+            while (table[j] != 0) j = (j + 1) & (uint64_t)(capacity - 1);
+            table[j] = entry;
+        }
+        free(searchIndex.table);
+        searchIndex.table = table;
+        searchIndex.tableCapacity = capacity;
+    }
+    if (searchIndex.termCount == searchIndex.termCapacity) {
+        int capacity = searchIndex.termCapacity ? searchIndex.termCapacity * 2 : 4096;
+        SearchTerm* terms = (SearchTerm*)realloc(searchIndex.terms, sizeof(SearchTerm) * capacity);
+        if (terms == NULL) return -1;
+        searchIndex.terms = terms;
+        searchIndex.termCapacity = capacity;
+    }
+    if (searchIndex.termTextSize + length > searchIndex.termTextCapacity) {
+        size_t capacity = searchIndex.termTextCapacity ? searchIndex.termTextCapacity * 2 : 65536;
+        char* text = (char*)realloc(searchIndex.termText, capacity);
+        if (text == NULL) return -1;
+        searchIndex.termText = text;
+        searchIndex.termTextCapacity = capacity;
+    }
+
+    SearchTerm* t = &searchIndex.terms[searchIndex.termCount];
+    memset(t, 0, sizeof(*t));
+    t->textOffset = (uint32_t)searchIndex.termTextSize;
+    t->length = (uint16_t)length;
+    memcpy(searchIndex.termText + searchIndex.termTextSize, term, length);
+    searchIndex.termTextSize += length;
+
+    searchIndex.table[probeSearchTerm(term, length, hash)] = (hash >> 32) << 32 | (uint64_t)(searchIndex.termCount + 1);
+    return searchIndex.termCount++;
+}
+
+static size_t putVarint(unsigned char* out, uint32_t value) {
+    size_t n = 0;
+    while (value >= 0x80) {
+        out[n++] = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    out[n++] = (unsigned char)value;
+    return n;
+}
+
+static uint32_t getVarint(const unsigned char** p) {
+    uint32_t value = 0;
+    int shift = 0;
+    while (**p & 0x80) {
+        value |= (uint32_t)(*(*p)++ & 0x7F) << shift;
+        shift += 7;
+    }
+    return value | (uint32_t)(*(*p)++) << shift;
+}
+
+// Returns -1 when out of memory; the index is then left empty and the next
+// search tries again
+int buildSearchIndex(void) {
+    char term[SEARCH_TERM_MAX];
+    size_t pairCount = 0, pairCapacity = 0;
+    int* pairTerms = NULL;                // term of each (slot, term) pair, slot by slot
+    int* slotStart = (int*)malloc(sizeof(int) * ((size_t)questionCount + 1));
+    int* lastSlot = NULL;                 // by term: last slot a pair was added for
+    int lastCapacity = 0;
+    int failed = slotStart == NULL;
+
+    freeSearchIndex();
+    if (searchFold['a'] == 0) initSearchFold();
+
+    // Pass 1: the dictionary and each slot's distinct terms
+    for (int slot = 0; slot < questionCount && !failed; slot++) {
+        const Question* q = &questions[slot];
+        const TextRef fields[5] = {q->question, q->optionA, q->optionB, q->optionC, q->optionD};
+        slotStart[slot] = (int)pairCount;
+        for (int f = 0; f < 5 && !failed; f++) {
+            const char* p = textOf(fields[f]);
+            const char* end = p + fields[f].length;
+            uint64_t hash;
+            int length;
+            while ((length = nextSearchTerm(&p, end, term, &hash)) > 0) {
+                int t = insertSearchTerm(term, length, hash);
+                if (t < 0) {
+                    failed = 1;
+                    break;
+                }
+                if (t >= lastCapacity) {
+                    int capacity = searchIndex.termCapacity;
+                    int* grown = (int*)realloc(lastSlot, sizeof(int) * capacity);
+                    if (grown == NULL) {
+                        failed = 1;
+                        break;
+                    }
+                    lastSlot = grown;
+                    for (int i = lastCapacity; i < capacity; i++) lastSlot[i] = -1;
+                    lastCapacity = capacity;
+                }
+                if (lastSlot[t] == slot) continue;
+                lastSlot[t] = slot;
+                if (pairCount == pairCapacity) {
+                    size_t capacity = pairCapacity ? pairCapacity * 2 : 65536;
+                    int* grown = (int*)realloc(pairTerms, sizeof(int) * capacity);
+                    if (grown == NULL) {
+                        failed = 1;
+                        break;
+                    }
+                    pairTerms = grown;
+                    pairCapacity = capacity;
+                }
+                pairTerms[pairCount++] = t;
+                searchIndex.terms[t].postingCount++;
+            }
+        }
+    }
+    free(lastSlot);
+
+    // Pass 2: lay out each term's postings (at most 5 bytes each) and skips
+    size_t byteBound = 0, skipCount = 0;
+    for (int t = 0; t < searchIndex.termCount && !failed; t++) {
+        SearchTerm* st = &searchIndex.terms[t];
+        st->postingOffset = byteBound;
+        st->skipOffset = (uint32_t)skipCount;
+        byteBound += (size_t)st->postingCount * 5;
+        skipCount += (st->postingCount + SEARCH_BLOCK_POSTINGS - 1) / SEARCH_BLOCK_POSTINGS;
+    }
+    unsigned char* postings = NULL;
+    uint32_t* written = NULL;
+    int* previous = NULL;
+    uint32_t* bytes = NULL;
+    if (!failed) {
+        postings = (unsigned char*)malloc(byteBound > 0 ? byteBound : 1);
+        searchIndex.skips = (SearchSkip*)malloc(sizeof(SearchSkip) * (skipCount > 0 ? skipCount : 1));
+        written = (uint32_t*)calloc(searchIndex.termCount > 0 ? searchIndex.termCount : 1, sizeof(uint32_t));
+        previous = (int*)malloc(sizeof(int) * (searchIndex.termCount > 0 ? searchIndex.termCount : 1));
+        bytes = (uint32_t*)calloc(searchIndex.termCount > 0 ? searchIndex.termCount : 1, sizeof(uint32_t));
+        failed = postings == NULL || searchIndex.skips == NULL || written == NULL || previous == NULL || bytes == NULL;
+    }
+    if (!failed) {
+        slotStart[questionCount] = (int)pairCount;
+        // Slots come in ascending order, so appending keeps every list sorted
+        for (int slot = 0; slot < questionCount; slot++) {
+            for (int k = slotStart[slot]; k < slotStart[slot + 1]; k++) {
+                int t = pairTerms[k];
+                const SearchTerm* st = &searchIndex.terms[t];
+                uint32_t n = written[t]++;
+                if (n % SEARCH_BLOCK_POSTINGS == 0) {
+                    SearchSkip* skip = &searchIndex.skips[st->skipOffset + n / SEARCH_BLOCK_POSTINGS];
+                    skip->firstSlot = slot;
+                    skip->byteOffset = bytes[t];
+                } else {
+                    bytes[t] += (uint32_t)putVarint(postings + st->postingOffset + bytes[t],
+                                                    (uint32_t)(slot - previous[t]));
+                }
+                previous[t] = slot;
+            }
+        }
+
+        // Pack the lists tightly now that their encoded sizes are known
+        size_t offset = 0;
+        for (int t = 0; t < searchIndex.termCount; t++) {
+            SearchTerm* st = &searchIndex.terms[t];
+            memmove(postings + offset, postings + st->postingOffset, bytes[t]);
+            st->postingOffset = offset;
+            offset += bytes[t];
+        }
+        unsigned char* packed = (unsigned char*)realloc(postings, offset > 0 ? offset : 1);
+        searchIndex.postings = packed != NULL ? packed : postings;  // a failed shrink keeps the larger buffer
+        searchIndex.postingSize = offset;
+        searchIndex.skipCount = skipCount;
+        searchIndex.version = bankVersion;
+    } else {
+        free(postings);
+    }
+    free(written);
+    free(previous);
+    free(bytes);
+    free(pairTerms);
+    free(slotStart);
+    if (failed) {
+        printf("Out of memory building the search index!\n");
+        freeSearchIndex();
+        return -1;
+    }
+    return 0;
+}
+
+void freeSearchIndex(void) {
+    free(searchIndex.terms);
+    free(searchIndex.table);
+    free(searchIndex.termText);
+    free(searchIndex.postings);
+    free(searchIndex.skips);
+    memset(&searchIndex, 0, sizeof(searchIndex));
+}
+
+// Walks one posting list; slot is INT_MAX once the list is exhausted
+typedef struct PostingCursor {
+    const SearchTerm* term;
+    const SearchSkip* skips;
+    const unsigned char* p;
+    uint32_t index;
+    int slot;
+} PostingCursor;
+
+static void postingSeekBlock(PostingCursor* c, uint32_t block) {
+    c->index = block * SEARCH_BLOCK_POSTINGS;
+    c->slot = c->skips[block].firstSlot;
+    c->p = searchIndex.postings + c->term->postingOffset + c->skips[block].byteOffset;
+}
+
+static void postingNext(PostingCursor* c) {
+    if (++c->index >= c->term->postingCount) c->slot = INT_MAX;
+    else if (c->index % SEARCH_BLOCK_POSTINGS == 0) postingSeekBlock(c, c->index / SEARCH_BLOCK_POSTINGS);
+    else c->slot += (int)getVarint(&c->p);
+}
+
+// Moves to the first posting >= target, skipping blocks that end before it
+static void postingAdvance(PostingCursor* c, int target) {
+    if (c->slot >= target) return;
+    uint32_t block = c->index / SEARCH_BLOCK_POSTINGS;
+    uint32_t blocks = (c->term->postingCount + SEARCH_BLOCK_POSTINGS - 1) / SEARCH_BLOCK_POSTINGS;
+    uint32_t next = block + 1;
+    while (next < blocks && c->skips[next].firstSlot <= target) next++;
+    if (next - 1 > block) postingSeekBlock(c, next - 1);
+    while (c->slot < target) postingNext(c);
+}
+
+static int comparePostingCursors(const void* x, const void* y) {
+    const PostingCursor* a = (const PostingCursor*)x;
+    const PostingCursor* b = (const PostingCursor*)y;
+    return (a->term->postingCount > b->term->postingCount) - (a->term->postingCount < b->term->postingCount);
+}
+
+// Finds the questions containing every word of the query. Returns how many
+// match (-1 for a query without words, -2 when the index cannot be built)
+// and stores the first maxSlots of them, in bank order, in slots.
+int searchQuestions(const char* query, int* slots, int maxSlots) {
+    PostingCursor cursors[SEARCH_MAX_TERMS];
+    char term[SEARCH_TERM_MAX];
+    int cursorCount = 0, length, matches = 0;
+    uint64_t hash;
+    const char* p = query;
+    const char* end = query + strlen(query);
+
+    if (searchIndex.version != bankVersion && buildSearchIndex() != 0) return -2;
+    if (searchFold['a'] == 0) initSearchFold();
+    while (cursorCount < SEARCH_MAX_TERMS && (length = nextSearchTerm(&p, end, term, &hash)) > 0) {
+        int t = findSearchTerm(term, length, hash);
+        if (t < 0) return 0;
+        int duplicate = 0;
+        for (int i = 0; i < cursorCount; i++) duplicate |= cursors[i].term == &searchIndex.terms[t];
+        if (duplicate) continue;
+        PostingCursor* c = &cursors[cursorCount++];
+        c->term = &searchIndex.terms[t];
+        c->skips = searchIndex.skips + c->term->skipOffset;
+        postingSeekBlock(c, 0);
+    }
+    if (cursorCount == 0) return -1;
+
+    // Rarest list leads; the others only confirm its candidates
+    qsort(cursors, cursorCount, sizeof(PostingCursor), comparePostingCursors);
+    PostingCursor* lead = &cursors[0];
+    while (lead->slot != INT_MAX) {
+        int candidate = lead->slot;
+        int agreed = 1;
+        for (int i = 1; i < cursorCount && agreed; i++) {
+            postingAdvance(&cursors[i], candidate);
+            if (cursors[i].slot != candidate) {
+                agreed = 0;
+                postingAdvance(lead, cursors[i].slot);
+            }
+        }
+        if (agreed) {
+            if (matches < maxSlots) slots[matches] = candidate;
+            matches++;
+            postingNext(lead);
+        }
+    }
+    return matches;
+}
+
+// Item Response Theory
+// Items follow the 3PL model P(correct | theta) = c + (1 - c) / (1 + e^(-a(theta - b))).
+// Uncalibrated items get parameters derived from their difficulty level.
+void setDefaultIrtParameters(Question* q) {
+    q->irtA = 1.0f;
+    q->irtB = q->difficulty == 1 ? -1.0f : q->difficulty == 3 ? 1.0f : 0.0f;
+    q->irtC = IRT_DEFAULT_GUESSING;
+}
+
+double irtProbability(const Question* q, double theta) {
+    return q->irtC + (1.0 - q->irtC) / (1.0 + exp(-q->irtA * (theta - q->irtB)));
+}
+
+// Fisher information of one item at theta
+double irtInformation(const Question* q, double theta) {
+    double p = irtProbability(q, theta);
+    double x = (p - q->irtC) / (1.0 - q->irtC);
+    return q->irtA * q->irtA * x * x * (1.0 - p) / p;
+}
+
+// Ability at which the item is most informative (b, shifted up by guessing)
+double irtPeakTheta(const Question* q) {
+    return q->irtB + log((1.0 + sqrt(1.0 + 8.0 * q->irtC)) / 2.0) / q->irtA;
+}
+
+static int compareIrtEntries(const void* x, const void* y) {
+    const IrtEntry* a = (const IrtEntry*)x;
+    const IrtEntry* b = (const IrtEntry*)y;
+    if (a->peak != b->peak) return a->peak < b->peak ? -1 : 1;
+    return a->slot - b->slot;
+}
+
+// Sorts every bank slot by information peak; rebuilt whenever the bank changes
+void buildIrtIndex(void) {
+    freeIrtIndex();
+    irtIndex = (IrtEntry*)malloc(sizeof(IrtEntry) * (questionCount > 0 ? questionCount : 1));
+    if (irtIndex == NULL) return;
+    for (int i = 0; i < questionCount; i++) {
+        irtIndex[i].peak = (float)irtPeakTheta(&questions[i]);
+        irtIndex[i].slot = i;
+    }
+    qsort(irtIndex, questionCount, sizeof(IrtEntry), compareIrtEntries);
+    irtIndexSize = questionCount;
+}
+
+void freeIrtIndex(void) {
+    free(irtIndex);
+    irtIndex = NULL;
+    irtIndexSize = 0;
+}
+
+// Binary-searches the index for the session's ability estimate and compares
+// up to IRT_CANDIDATE_WINDOW unasked items on each side, returning the one
+// with the most information. Asked items are skipped, so a pick costs
+// O(log N + window + exam length).
+Question* selectIrtQuestion(ExamSession* s) {
+    int low = 0, high = irtIndexSize;
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+        if (irtIndex[mid].peak < s->theta) low = mid + 1;
+        else high = mid;
+    }
+
+    Question* best = NULL;
+    double bestInformation = -1.0;
+    int left = low - 1, right = low;
+    int leftFound = 0, rightFound = 0;
+    while ((left >= 0 && leftFound < IRT_CANDIDATE_WINDOW) ||
+           (right < irtIndexSize && rightFound < IRT_CANDIDATE_WINDOW)) {
+        int slot = -1;
+        if (right < irtIndexSize && rightFound < IRT_CANDIDATE_WINDOW) {
+            slot = irtIndex[right++].slot;
+            if (!isAsked(&s->asked, slot)) rightFound++;
+            else slot = -1;
+        } else {
+            slot = irtIndex[left--].slot;
+            if (!isAsked(&s->asked, slot)) leftFound++;
+            else slot = -1;
+        }
+        if (slot < 0) continue;
+        double information = irtInformation(&questions[slot], s->theta);
+        if (information > bestInformation) {
+            bestInformation = information;
+            best = &questions[slot];
+        }
+    }
+    return best;
+}
+
+// The ability estimate is the posterior mean (EAP) over a fixed grid with a
+// standard normal prior; each answer adds its log-likelihood to the grid.
+// Skipped questions carry no information and leave the estimate alone.
+void initAbilityEstimate(ExamSession* s) {
+    for (int g = 0; g < IRT_GRID_POINTS; g++) {
+        double theta = IRT_GRID_MIN + g * IRT_GRID_STEP;
+        s->abilityLogPosterior[g] = -0.5 * theta * theta;
+    }
+    s->theta = 0.0;
+    s->thetaSE = 1.0;
+}
+
+void updateAbilityEstimate(ExamSession* s, const Question* q, int isCorrect) {
+    double largest = -INFINITY;
+    for (int g = 0; g < IRT_GRID_POINTS; g++) {
+        double p = irtProbability(q, IRT_GRID_MIN + g * IRT_GRID_STEP);
+        s->abilityLogPosterior[g] += log(isCorrect ? p : 1.0 - p);
+        if (s->abilityLogPosterior[g] > largest) largest = s->abilityLogPosterior[g];
+    }
+
+    double weightSum = 0.0, mean = 0.0, square = 0.0;
+    for (int g = 0; g < IRT_GRID_POINTS; g++) {
+        double theta = IRT_GRID_MIN + g * IRT_GRID_STEP;
+        double weight = exp(s->abilityLogPosterior[g] - largest);
+        weightSum += weight;
+        mean += weight * theta;
+        square += weight * theta * theta;
+    }
+    mean /= weightSum;
+    s->theta = mean;
+    s->thetaSE = sqrt(fmax(square / weightSum - mean * mean, 0.0));
+}
+
+// Response Timing
+uint64_t monotonicNs(void) {
+#ifdef _WIN32
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (uint64_t)(counter.QuadPart / frequency.QuadPart) * 1000000000ULL +
+           (uint64_t)(counter.QuadPart % frequency.QuadPart) * 1000000000ULL / (uint64_t)frequency.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+// Command-line durations; anything not positive means no limit (0)
+uint64_t secondsToNs(double seconds) {
+    return seconds > 0.0 ? (uint64_t)(seconds * 1e9) : 0;
+}
+
+// Log-scale bucket of a value: values below 2^subBits get their own bucket,
+// larger values share 2^subBits buckets per power of two, so the relative
+// error stays below 2^-subBits.
+int histogramIndex(uint64_t value, int subBits) {
+    uint64_t subCount = 1ULL << subBits;
+    if (value < subCount) return (int)value;
+    int exponent = 63 - __builtin_clzll(value);
+    int sub = (int)((value >> (exponent - subBits)) & (subCount - 1));
+    return (exponent - subBits + 1) * (int)subCount + sub;
+}
+
+uint64_t histogramLowerBound(int index, int subBits) {
+    int subCount = 1 << subBits;
+    if (index < subCount) return (uint64_t)index;
+    int exponent = index / subCount + subBits - 1;
+    return (uint64_t)(subCount + index % subCount) << (exponent - subBits);
+}
+
+// Value at percentile p (0-100), reported as the lower bound of its bucket
+uint64_t histogramPercentile(const uint32_t* buckets, int bucketCount, int subBits,
+                             uint64_t count, double p) {
+    if (count == 0) return 0;
+    uint64_t rank = (uint64_t)(p / 100.0 * (double)(count - 1)) + 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < bucketCount; i++) {
+        seen += buckets[i];
+        if (seen >= rank) return histogramLowerBound(i, subBits);
+    }
+    return histogramLowerBound(bucketCount - 1, subBits);
+}
+
+void recordLatency(LatencyHistogram* h, uint64_t ns) {
+    h->buckets[histogramIndex(ns, HIST_SUB_BITS)]++;
+    h->count++;
+    h->totalNs += ns;
+    if (ns > h->maxNs) h->maxNs = ns;
+}
+
+// Per-question histograms are allocated on the first answer only
+void recordQuestionLatency(const Question* q, uint64_t ns) {
+    QuestionLatency** latency = &questionLatency[q - questions];
+    if (*latency == NULL) {
+        *latency = (QuestionLatency*)calloc(1, sizeof(QuestionLatency));
+        if (*latency == NULL) return;
+    }
+    int index = histogramIndex(ns, 0);
+    if (index >= QUESTION_HIST_BUCKETS) index = QUESTION_HIST_BUCKETS - 1;
+    (*latency)->buckets[index]++;
+    (*latency)->count++;
+    (*latency)->totalNs += ns;
+}
+
+uint64_t questionLatencyMedian(const Question* q) {
+    const QuestionLatency* latency = questionLatency[q - questions];
+    if (latency == NULL) return 0;
+    return histogramPercentile(latency->buckets, QUESTION_HIST_BUCKETS, 0, latency->count, 50.0);
+}
+
+void formatDuration(uint64_t ns, char* buffer, size_t size) {
+    if (ns < 1000ULL) snprintf(buffer, size, "%lluns", (unsigned long long)ns);
+    else if (ns < 1000000ULL) snprintf(buffer, size, "%.1fus", ns / 1e3);
+    else if (ns < 1000000000ULL) snprintf(buffer, size, "%.1fms", ns / 1e6);
+    else snprintf(buffer, size, "%.2fs", ns / 1e9);
+}
+
+// Prints percentiles and a bar per power of two for one histogram
+void displayLatencyHistogram(const LatencyHistogram* h) {
+    char mean[16], p50[16], p90[16], p99[16], max[16];
+    if (h->count == 0) {
+        printf("  Answer time: no answers yet\n");
+        return;
+    }
+
+    formatDuration(h->totalNs / h->count, mean, sizeof(mean));
+    formatDuration(histogramPercentile(h->buckets, HIST_BUCKETS, HIST_SUB_BITS, h->count, 50.0), p50, sizeof(p50));
+    formatDuration(histogramPercentile(h->buckets, HIST_BUCKETS, HIST_SUB_BITS, h->count, 90.0), p90, sizeof(p90));
+    formatDuration(histogramPercentile(h->buckets, HIST_BUCKETS, HIST_SUB_BITS, h->count, 99.0), p99, sizeof(p99));
+    formatDuration(h->maxNs, max, sizeof(max));
+    printf("  Answer time: mean %s | p50 %s | p90 %s | p99 %s | max %s\n", mean, p50, p90, p99, max);
+
+    uint64_t octave[64] = {0};
+    uint64_t largest = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        if (h->buckets[i] == 0) continue;
+        int bit = histogramLowerBound(i, HIST_SUB_BITS) == 0 ? 0 :
+                  63 - __builtin_clzll(histogramLowerBound(i, HIST_SUB_BITS));
+        octave[bit] += h->buckets[i];
+        if (octave[bit] > largest) largest = octave[bit];
+    }
+    for (int bit = 0; bit < 64; bit++) {
+        if (octave[bit] == 0) continue;
+        char from[16], to[16];
+        formatDuration(bit == 0 ? 0 : 1ULL << bit, from, sizeof(from));
+        formatDuration(2ULL << bit, to, sizeof(to));
+        int width = (int)(octave[bit] * 30 / largest);
+        printf("  %8s - %-8s |%-30.*s| %llu\n", from, to, width > 0 ? width : 1,
+               "##############################", (unsigned long long)octave[bit]);
+    }
+}
+
+// Exam History Log
+// Finished exams are appended as fixed-size records to a binary log:
+//   HistoryHeader, then ExamRecord * n
+// Appends go straight to the file and are fsync'ed every HISTORY_SYNC_BATCH
+// records and on close. Readers map the file and walk it sequentially, so
+// the history can grow to millions of exams without being held in memory.
+
+// Opens (or creates) a log of fixed-size records behind a HistoryHeader for
+// appending; returns the descriptor, or -1 with a message naming the log
+static int openRecordLog(const char* path, const char* magic, uint32_t version,
+                         size_t recordSize, const char* name) {
+    HistoryHeader header;
+    struct stat st;
+
+    int fd = open(path, HISTORY_OPEN_FLAGS, 0644);
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        printf("Cannot open %s: %s\n", name, path);
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+
+    if (st.st_size == 0) {
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, magic, sizeof(header.magic));
+        header.version = version;
+        header.recordSize = (uint32_t)recordSize;
+        if (write(fd, &header, sizeof(header)) != (ssize_t)sizeof(header)) {
+            printf("Cannot write %s: %s\n", name, path);
+            close(fd);
+            return -1;
+        }
+        st.st_size = sizeof(header);
+    } else if (read(fd, &header, sizeof(header)) != (ssize_t)sizeof(header) ||
+               memcmp(header.magic, magic, sizeof(header.magic)) != 0 ||
+               header.version != version || header.recordSize != recordSize) {
+        printf("%s is not an %s (or has an unsupported version)\n", path, name);
+        close(fd);
+        return -1;
+    }
+
+    // A crash mid-append can leave a partial record at the end; drop it so
+    // later appends stay aligned
+    off_t payload = st.st_size - (off_t)sizeof(HistoryHeader);
+    if (payload % (off_t)recordSize != 0) {
+        printf("Dropping a partial record at the end of %s\n", path);
+        payload -= payload % (off_t)recordSize;
+        if (ftruncate(fd, (off_t)sizeof(HistoryHeader) + payload) != 0) {
+            close(fd);
+            return -1;
+        }
+    }
+    return fd;
+}
+
+int openHistoryLog(const char* path) {
+    historyFd = openRecordLog(path, HISTORY_MAGIC, HISTORY_VERSION, sizeof(ExamRecord), "exam history log");
+    if (historyFd < 0) return -1;
+
+    historyPath = path;
+    historyUnsynced = 0;
+
+    // One pass over the existing log seeds the exam totals; from here on
+    // they are updated per appended exam. Totals restored from a snapshot
+    // already cover the start of the log, so only newer records are read.
+    char* mapping;
+    size_t mappedSize;
+    long long recordCount;
+    const ExamRecord* records = mapHistoryRecords(&mapping, &mappedSize, &recordCount);
+    long long first = 0;
+    if (snapshotExamRecords >= 0 && snapshotExamRecords <= recordCount) {
+        first = snapshotExamRecords;
+    } else {
+        atomic_store(&aggregates.examCount, 0);
+        atomic_store(&aggregates.scoreSumMilli, 0);
+    }
+    for (long long r = first; r < recordCount; r++) {
+        countExam(recordScore(&records[r]));
+    }
+    unmapFile(mapping, mappedSize);
+    return 0;
+}
+
+void closeHistoryLog(void) {
+    if (historyFd < 0) return;
+    if (historyUnsynced > 0) fsync(historyFd);
+    close(historyFd);
+    historyFd = -1;
+    historyUnsynced = 0;
+}
+
+int appendExamRecord(const ExamStats* stats) {
+    ExamRecord record;
+    if (historyFd < 0) return -1;
+
+    memset(&record, 0, sizeof(record));
+    record.finishedAt = (uint64_t)time(NULL);
+    record.timeTakenNs = stats->timeTakenNs;
+    record.totalQuestions = stats->totalQuestions;
+    record.correctAnswers = stats->correctAnswers;
+    record.wrongAnswers = stats->wrongAnswers;
+    record.skippedQuestions = stats->skippedQuestions;
+    record.averageDifficulty = stats->averageDifficulty;
+    return appendExamRecords(&record, 1);
+}
+
+// Appends records with as few writes as possible; safe to call from any thread
+int appendExamRecords(const ExamRecord* records, int count) {
+    const char* data = (const char*)records;
+    size_t remaining = sizeof(ExamRecord) * (size_t)count;
+    int status = 0;
+    if (historyFd < 0) return -1;
+
+    acquireFlag(&historyLock);
+    while (remaining > 0) {
+        ssize_t written = write(historyFd, data, remaining);
+        if (written <= 0) {
+            printf("Failed to append to the exam history log!\n");
+            status = -1;
+            break;
+        }
+        data += written;
+        remaining -= (size_t)written;
+    }
+    // Only whole records count; a torn tail is dropped on the next open
+    int appended = (int)((sizeof(ExamRecord) * (size_t)count - remaining) / sizeof(ExamRecord));
+    for (int i = 0; i < appended; i++) {
+        countExam(recordScore(&records[i]));
+    }
+    historyUnsynced += appended;
+    if (historyUnsynced >= HISTORY_SYNC_BATCH) {
+        fsync(historyFd);
+        historyUnsynced = 0;
+    }
+    releaseFlag(&historyLock);
+    return status;
+}
+
+// Maps the whole log read-only; the caller releases it with unmapFile()
+const ExamRecord* mapHistoryRecords(char** mapping, size_t* mappedSize, long long* count) {
+    *mapping = historyPath != NULL ? mapFile(historyPath, mappedSize) : NULL;
+    if (*mapping == NULL || *mappedSize < sizeof(HistoryHeader)) {
+        *count = 0;
+        return NULL;
+    }
+#if !defined(_WIN32)
+    madvise(*mapping, *mappedSize, MADV_SEQUENTIAL);
+#endif
+    *count = (long long)((*mappedSize - sizeof(HistoryHeader)) / sizeof(ExamRecord));
+    return (const ExamRecord*)(*mapping + sizeof(HistoryHeader));
+}
+
+float recordScore(const ExamRecord* record) {
+    if (record->totalQuestions <= 0) return 0.0f;
+    return (float)record->correctAnswers / record->totalQuestions * 100.0f;
+}
+
+// Response Log
+// Every question asked in an exam or found on a graded sheet is appended to
+// a second log, one ResponseRecord each, for item analysis:
+//   HistoryHeader (RESPONSE_MAGIC), then ResponseRecord * n
+// Sessions collect their responses and append them in one write when they
+// finish; grading workers append whole batches of sheets.
+int openResponseLog(const char* path) {
+    responseFd = openRecordLog(path, RESPONSE_MAGIC, RESPONSE_VERSION, sizeof(ResponseRecord),
+                               "exam response log");
+    if (responseFd < 0) return -1;
+    responsePath = path;
+    responseUnsynced = 0;
+    return 0;
+}
+
+void closeResponseLog(void) {
+    if (responseFd < 0) return;
+    if (responseUnsynced > 0) fsync(responseFd);
+    close(responseFd);
+    responseFd = -1;
+    responseUnsynced = 0;
+}
+
+// Appends responses in one locked write; safe to call from any thread
+int appendResponses(const ResponseRecord* records, int count) {
+    const char* data = (const char*)records;
+    size_t remaining = sizeof(ResponseRecord) * (size_t)count;
+    int status = 0;
+    if (responseFd < 0 || count == 0) return responseFd < 0 ? -1 : 0;
+
+    acquireFlag(&responseLock);
+    while (remaining > 0) {
+        ssize_t written = write(responseFd, data, remaining);
+        if (written <= 0) {
+            printf("Failed to append to the exam response log!\n");
+            status = -1;
+            break;
+        }
+        data += written;
+        remaining -= (size_t)written;
+    }
+    if (++responseUnsynced >= HISTORY_SYNC_BATCH) {
+        fsync(responseFd);
+        responseUnsynced = 0;
+    }
+    releaseFlag(&responseLock);
+    return status;
+}
+
+// Notes one asked question of the session; the exam score is filled in
+// when the session finishes
+void recordResponse(ExamSession* s, const Question* q, char answer, int isCorrect, uint64_t timeNs) {
+    if (s->responseCount >= MAX_EXAM_QUESTIONS) return;
+    ResponseRecord* r = &s->responses[s->responseCount];
+    int option = toupper((unsigned char)answer) - 'A';
+    memset(r, 0, sizeof(*r));
+    r->questionId = q->id;
+    r->formId = RESPONSE_NO_FORM;
+    r->timeMs = timeNs / 1000000 > UINT32_MAX ? UINT32_MAX : (uint32_t)(timeNs / 1000000);
+    r->position = (uint8_t)s->responseCount;
+    r->answer = option >= 0 && option <= 3 ? (uint8_t)option : RESPONSE_SKIPPED;
+    r->isCorrect = (uint8_t)isCorrect;
+    s->responseCount++;
+}
+
+// Timer Wheel
+void initTimerWheel(TimerWheel* w, uint64_t nowNs) {
+    for (int i = 0; i < TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS; i++) {
+        w->heads[i].next = &w->heads[i];
+        w->heads[i].prev = &w->heads[i];
+    }
+    memset(w->occupied, 0, sizeof(w->occupied));
+    w->now = 0;
+    w->originNs = nowNs;
+    w->count = 0;
+}
+
+// Links a timer into the slot covering its tick. A timer already due goes
+// into the current level-0 slot, which advanceTimerWheel() fires next.
+static void placeTimer(TimerWheel* w, TimerEntry* e) {
+    uint64_t at = e->expires > w->now ? e->expires : w->now;
+    uint64_t delta = at - w->now;
+    int level = 0;
+    if (delta >= (1ULL << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS))) {
+        // Beyond the wheel: park in the farthest slot, re-placed when reached
+        level = TIMER_WHEEL_LEVELS - 1;
+        at = w->now + (1ULL << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS)) - 1;
+    } else if (delta > 0) {
+        level = (63 - __builtin_clzll(delta)) / TIMER_WHEEL_BITS;
+    }
+    int index = (int)((at >> (TIMER_WHEEL_BITS * level)) & (TIMER_WHEEL_SLOTS - 1));
+    TimerEntry* head = &w->heads[level * TIMER_WHEEL_SLOTS + index];
+    e->slot = level * TIMER_WHEEL_SLOTS + index;
+    e->prev = head->prev;
+    e->next = head;
+    head->prev->next = e;
+    head->prev = e;
+    w->occupied[level] |= 1ULL << index;
+}
+
+static void unlinkTimer(TimerWheel* w, TimerEntry* e) {
+    e->prev->next = e->next;
+    e->next->prev = e->prev;
+    TimerEntry* head = &w->heads[e->slot];
+    if (head->next == head) {
+        w->occupied[e->slot / TIMER_WHEEL_SLOTS] &= ~(1ULL << (e->slot % TIMER_WHEEL_SLOTS));
+    }
+    e->next = NULL;
+    e->prev = NULL;
+}
+
+// Arms (or moves) a timer to fire on the first tick at or after deadlineNs
+void armTimer(TimerWheel* w, TimerEntry* e, uint64_t deadlineNs) {
+    if (e->next != NULL) {
+        unlinkTimer(w, e);
+    } else {
+        w->count++;
+    }
+    uint64_t sinceOrigin = deadlineNs > w->originNs ? deadlineNs - w->originNs : 0;
+    e->expires = (sinceOrigin + TIMER_TICK_NS - 1) / TIMER_TICK_NS;
+    if (e->expires <= w->now) e->expires = w->now + 1;  // the current tick has been processed
+    placeTimer(w, e);
+}
+
+void cancelTimer(TimerWheel* w, TimerEntry* e) {
+    if (e->next == NULL) return;
+    unlinkTimer(w, e);
+    w->count--;
+}
+
+// Processes every tick up to nowNs and calls back each timer that came due.
+// Timers are unlinked before their callback, which may re-arm them or free
+// their owner. Returns the number of timers fired.
+int advanceTimerWheel(TimerWheel* w, uint64_t nowNs, TimerCallback callback, void* context) {
+    uint64_t target = nowNs > w->originNs ? (nowNs - w->originNs) / TIMER_TICK_NS : 0;
+    int fired = 0;
+    while (w->now < target) {
+        uint64_t next = w->now + 1;
+        if (w->occupied[0] == 0) {
+            // Nothing can fire before level 0 wraps and a slot comes down
+            next = (w->now | (TIMER_WHEEL_SLOTS - 1)) + 1;
+            if (next > target) {
+                w->now = target;
+                break;
+            }
+        }
+        w->now = next;
+
+        for (int level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+            int shift = TIMER_WHEEL_BITS * level;
+            if (w->now & ((1ULL << shift) - 1)) break;
+            int index = (int)((w->now >> shift) & (TIMER_WHEEL_SLOTS - 1));
+            TimerEntry* head = &w->heads[level * TIMER_WHEEL_SLOTS + index];
+            while (head->next != head) {
+                TimerEntry* e = head->next;
+                unlinkTimer(w, e);
+                placeTimer(w, e);
+            }
+        }
+
+        TimerEntry* head = &w->heads[w->now & (TIMER_WHEEL_SLOTS - 1)];
+        while (head->next != head) {
+            TimerEntry* e = head->next;
+            unlinkTimer(w, e);
+            w->count--;
+            fired++;
+            callback(context, e);
+        }
+    }
+    return fired;
+}
+
+// Nanoseconds until the wheel next has work (a timer due or a slot to bring
+// down a level), or -1 when nothing is armed. Sleeping this long between
+// advances fires every timer within one tick of its deadline.
+int64_t timerWheelWaitNs(const TimerWheel* w, uint64_t nowNs) {
+    if (w->count == 0) return -1;
+    uint64_t nextTick = UINT64_MAX;
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        uint64_t bits = w->occupied[level];
+        if (bits == 0) continue;
+        int shift = TIMER_WHEEL_BITS * level;
+        // Slots after the current one come round first, the current one last
+        int start = (int)(((w->now >> shift) + 1) & (TIMER_WHEEL_SLOTS - 1));
+        uint64_t rotated = start == 0 ? bits : (bits >> start) | (bits << (TIMER_WHEEL_SLOTS - start));
+        uint64_t tick = ((w->now >> shift) + 1 + (uint64_t)__builtin_ctzll(rotated)) << shift;
+        if (tick < nextTick) nextTick = tick;
+    }
+    uint64_t dueNs = w->originNs + nextTick * TIMER_TICK_NS;
+    return dueNs > nowNs ? (int64_t)(dueNs - nowNs) : 0;
+}
+
+// Thread Pool
+int hardwareThreads(void) {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (int)count : 1;
+#endif
+}
+
+// Spin lock for short critical sections; yields while waiting so an owner
+// that was descheduled can finish
+void acquireFlag(atomic_flag* flag) {
+    while (atomic_flag_test_and_set_explicit(flag, memory_order_acquire)) {
+#ifdef _WIN32
+        SwitchToThread();
+#else
+        sched_yield();
+#endif
+    }
+}
+
+void releaseFlag(atomic_flag* flag) {
+    atomic_flag_clear_explicit(flag, memory_order_release);
+}
+
+static void runParallelTasks(ParallelWorker* worker) {
+    ParallelRun* run = worker->run;
+    int task;
+    while ((task = atomic_fetch_add_explicit(&run->nextTask, 1, memory_order_relaxed)) < run->taskCount) {
+        run->function(run->context, worker->index, task);
+    }
+}
+
+#ifdef _WIN32
+static DWORD WINAPI parallelThreadMain(LPVOID arg) {
+    runParallelTasks((ParallelWorker*)arg);
+    return 0;
+}
+#else
+static void* parallelThreadMain(void* arg) {
+    runParallelTasks((ParallelWorker*)arg);
+    return NULL;
+}
+#endif
+
+// Runs function(context, worker, task) for every task in [0, taskCount) on
+// up to workerCount threads; the caller is worker 0. Tasks are handed out
+// from a shared counter, so uneven tasks balance themselves.
+void parallelFor(int workerCount, int taskCount, TaskFunction function, void* context) {
+    ParallelRun run;
+    run.function = function;
+    run.context = context;
+    run.taskCount = taskCount;
+    atomic_init(&run.nextTask, 0);
+    if (workerCount < 1) workerCount = 1;
+
+    ParallelWorker* workers = (ParallelWorker*)malloc(sizeof(ParallelWorker) * workerCount);
+#ifdef _WIN32
+    HANDLE* threads = (HANDLE*)malloc(sizeof(HANDLE) * workerCount);
+#else
+    pthread_t* threads = (pthread_t*)malloc(sizeof(pthread_t) * workerCount);
+#endif
+    if (workers == NULL || threads == NULL) workerCount = 1;
+
+    int started = 1;
+    for (int i = 1; i < workerCount; i++) {
+        workers[i].run = &run;
+        workers[i].index = i;
+#ifdef _WIN32
+        threads[i] = CreateThread(NULL, 0, parallelThreadMain, &workers[i], 0, NULL);
+        if (threads[i] == NULL) break;
+#else
+        if (pthread_create(&threads[i], NULL, parallelThreadMain, &workers[i]) != 0) break;
+#endif
+        started++;
+    }
+
+    ParallelWorker self = {&run, 0};
+    runParallelTasks(&self);
+
+    for (int i = 1; i < started; i++) {
+#ifdef _WIN32
+        WaitForSingleObject(threads[i], INFINITE);
+        CloseHandle(threads[i]);
+#else
+        pthread_join(threads[i], NULL);
+#endif
+    }
+    free(threads);
+    free(workers);
+}
+
+// Answer Event Pipeline
+// The answer path publishes one event per graded answer into a bounded
+// lock-free ring (Vyukov's sequence-numbered cells, many producers, one
+// consumer) and returns. A single aggregator thread drains the ring in
+// batches and applies them to the per-question counters, the latency
+// histograms, the slow board and the per-difficulty totals, so those are
+// written by one thread and answering never waits on statistics. Without a
+// running aggregator events are applied inline. If the ring is full the
+// producer applies its event itself under the aggregator's batch lock.
+int initAnswerQueue(size_t capacity) {
+    answerQueue.cells = (AnswerCell*)malloc(sizeof(AnswerCell) * capacity);
+    if (answerQueue.cells == NULL) return -1;
+    for (size_t i = 0; i < capacity; i++) atomic_init(&answerQueue.cells[i].sequence, i);
+    answerQueue.mask = capacity - 1;
+    atomic_init(&answerQueue.enqueuePos, 0);
+    atomic_init(&answerQueue.appliedPos, 0);
+    atomic_init(&answerQueue.sleeping, 0);
+    answerQueue.dequeuePos = 0;
+#ifdef _WIN32
+    InitializeCriticalSection(&answerQueue.wakeLock);
+    InitializeConditionVariable(&answerQueue.wake);
+#else
+    pthread_mutex_init(&answerQueue.wakeLock, NULL);
+    pthread_cond_init(&answerQueue.wake, NULL);
+#endif
+    return 0;
+}
+
+static void wakeAggregator(void) {
+#ifdef _WIN32
+    EnterCriticalSection(&answerQueue.wakeLock);
+    WakeConditionVariable(&answerQueue.wake);
+    LeaveCriticalSection(&answerQueue.wakeLock);
+#else
+    pthread_mutex_lock(&answerQueue.wakeLock);
+    pthread_cond_signal(&answerQueue.wake);
+    pthread_mutex_unlock(&answerQueue.wakeLock);
+#endif
+}
+
+// Returns 0 when the ring is full
+int tryPublishAnswerEvent(const AnswerEvent* event) {
+    size_t pos = atomic_load_explicit(&answerQueue.enqueuePos, memory_order_relaxed);
+    AnswerCell* cell;
+    for (;;) {
+        cell = &answerQueue.cells[pos & answerQueue.mask];
+        size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        intptr_t difference = (intptr_t)sequence - (intptr_t)pos;
+        if (difference == 0) {
+            if (atomic_compare_exchange_weak_explicit(&answerQueue.enqueuePos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (difference < 0) {
+            return 0;
+        } else {
+            pos = atomic_load_explicit(&answerQueue.enqueuePos, memory_order_relaxed);
+        }
+    }
+    cell->event = *event;
+    atomic_store_explicit(&cell->sequence, pos + 1, memory_order_release);
+    // Pairs with the fence in aggregatorPause: either the aggregator sees
+    // this event before parking or we see it parked and wake it
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&answerQueue.sleeping, memory_order_relaxed)) wakeAggregator();
+    return 1;
+}
+
+void publishAnswerEvent(const AnswerEvent* event) {
+    if (!atomic_load_explicit(&answerQueue.running, memory_order_acquire)) {
+        applyAnswerEvent(event);
+    } else if (!tryPublishAnswerEvent(event)) {
+        acquireFlag(&answerQueue.applyLock);
+        applyAnswerEvent(event);
+        releaseFlag(&answerQueue.applyLock);
+    }
+}
+
+void applyAnswerEvent(const AnswerEvent* event) {
+    const Question* q = &questions[event->slot];
+    atomic_fetch_add_explicit(&questionAttempts[event->slot], 1, memory_order_relaxed);
+    if (event->isCorrect) {
+        atomic_fetch_add_explicit(&questionCorrect[event->slot], 1, memory_order_relaxed);
+    }
+    recordQuestionLatency(q, event->timeNs);
+    updateSlowQuestions(q);
+    if (q->difficulty >= 1 && q->difficulty <= 3) {
+        atomic_fetch_add_explicit(&aggregates.attempts[q->difficulty], 1, memory_order_relaxed);
+        if (event->isCorrect) {
+            atomic_fetch_add_explicit(&aggregates.correct[q->difficulty], 1, memory_order_relaxed);
+        }
+        recordLatency(&difficultyLatency[q->difficulty], event->timeNs);
+    }
+}
+
+// Applies up to ANSWER_DRAIN_BATCH queued events; returns how many
+static int drainAnswerEvents(void) {
+    int drained = 0;
+    acquireFlag(&answerQueue.applyLock);
+    while (drained < ANSWER_DRAIN_BATCH) {
+        size_t pos = answerQueue.dequeuePos;
+        AnswerCell* cell = &answerQueue.cells[pos & answerQueue.mask];
+        if (atomic_load_explicit(&cell->sequence, memory_order_acquire) != pos + 1) break;
+        AnswerEvent event = cell->event;
+        atomic_store_explicit(&cell->sequence, pos + answerQueue.mask + 1, memory_order_release);
+        answerQueue.dequeuePos = pos + 1;
+        applyAnswerEvent(&event);
+        drained++;
+    }
+    releaseFlag(&answerQueue.applyLock);
+    if (drained > 0) {
+        atomic_store_explicit(&answerQueue.appliedPos, answerQueue.dequeuePos, memory_order_release);
+    }
+    return drained;
+}
+
+// Parks the aggregator until a producer publishes into the empty ring or
+// stopAnswerAggregator() asks it to exit
+static void aggregatorPause(void) {
+#ifdef _WIN32
+    EnterCriticalSection(&answerQueue.wakeLock);
+#else
+    pthread_mutex_lock(&answerQueue.wakeLock);
+#endif
+    atomic_store_explicit(&answerQueue.sleeping, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    size_t pos = answerQueue.dequeuePos;
+    AnswerCell* cell = &answerQueue.cells[pos & answerQueue.mask];
+    while (atomic_load_explicit(&cell->sequence, memory_order_acquire) != pos + 1 &&
+           !atomic_load_explicit(&answerQueue.stopping, memory_order_acquire)) {
+#ifdef _WIN32
+        SleepConditionVariableCS(&answerQueue.wake, &answerQueue.wakeLock, INFINITE);
+#else
+        pthread_cond_wait(&answerQueue.wake, &answerQueue.wakeLock);
+#endif
+    }
+    atomic_store_explicit(&answerQueue.sleeping, 0, memory_order_relaxed);
+#ifdef _WIN32
+    LeaveCriticalSection(&answerQueue.wakeLock);
+#else
+    pthread_mutex_unlock(&answerQueue.wakeLock);
+#endif
+}
+
+#ifdef _WIN32
+static DWORD WINAPI answerAggregatorMain(LPVOID arg) {
+#else
+static void* answerAggregatorMain(void* arg) {
+#endif
+    (void)arg;
+    int idle = 0;
+    for (;;) {
+        if (drainAnswerEvents() > 0) {
+            idle = 0;
+        } else if (atomic_load_explicit(&answerQueue.stopping, memory_order_acquire)) {
+            break;
+        } else if (++idle < ANSWER_IDLE_SPINS) {
+#ifdef _WIN32
+            SwitchToThread();
+#else
+            sched_yield();
+#endif
+        } else {
+            aggregatorPause();
+        }
+    }
+    return 0;
+}
+
+int startAnswerAggregator(void) {
+    if (atomic_load(&answerQueue.running)) return 0;
+    if (answerQueue.cells == NULL && initAnswerQueue(ANSWER_QUEUE_CAPACITY) != 0) return -1;
+    atomic_store(&answerQueue.stopping, 0);
+#ifdef _WIN32
+    answerQueue.thread = CreateThread(NULL, 0, answerAggregatorMain, NULL, 0, NULL);
+    if (answerQueue.thread == NULL) return -1;
+#else
+    if (pthread_create(&answerQueue.thread, NULL, answerAggregatorMain, NULL) != 0) return -1;
+#endif
+    atomic_store_explicit(&answerQueue.running, 1, memory_order_release);
+    return 0;
+}
+
+// Waits until every event published so far has been applied
+void flushAnswerEvents(void) {
+    if (!atomic_load_explicit(&answerQueue.running, memory_order_acquire)) return;
+    size_t target = atomic_load_explicit(&answerQueue.enqueuePos, memory_order_acquire);
+    while (atomic_load_explicit(&answerQueue.appliedPos, memory_order_acquire) < target) {
+#ifdef _WIN32
+        SwitchToThread();
+#else
+        sched_yield();
+#endif
+    }
+}
+
+// Drains what is left and stops the thread; call once no more answers are
+// coming in. Later events are applied inline.
+void stopAnswerAggregator(void) {
+    if (!atomic_load(&answerQueue.running)) return;
+    atomic_store_explicit(&answerQueue.stopping, 1, memory_order_release);
+    wakeAggregator();
+#ifdef _WIN32
+    WaitForSingleObject(answerQueue.thread, INFINITE);
+    CloseHandle(answerQueue.thread);
+#else
+    pthread_join(answerQueue.thread, NULL);
+#endif
+    atomic_store(&answerQueue.running, 0);
+    drainAnswerEvents();  // events published while the thread was exiting
+    free(answerQueue.cells);
+    answerQueue.cells = NULL;
+#ifdef _WIN32
+    DeleteCriticalSection(&answerQueue.wakeLock);
+#else
+    pthread_mutex_destroy(&answerQueue.wakeLock);
+    pthread_cond_destroy(&answerQueue.wake);
+#endif
+}
+
+// Batch Grading
+// A sheet file starts with the answer forms, then holds one sheet per line:
+//   FORM <formId> <questionId> <questionId> ...
+//   <formId> <answers>
+// where answers has one character per item of the form: A-D, or S / - for
+// a blank. Sheets are graded in parallel, GRADE_CHUNK_BYTES of the mapped
+// file per task. Each sheet updates the same per-question attempts/correct
+// counts and appends the same ExamStats record as an interactive exam
+// (blanks count as skipped and wrong; paper sheets have no answer times).
+
+static int compareAnswerForms(const void* x, const void* y) {
+    const AnswerForm* a = (const AnswerForm*)x;
+    const AnswerForm* b = (const AnswerForm*)y;
+    return (a->id > b->id) - (a->id < b->id);
+}
+
+// Parses the FORM lines at the top of the file; returns -1 on a bad form
+// or a form id defined twice
+int loadAnswerForms(GradeJob* job) {
+    const char* p = job->data;
+    const char* end = job->data + job->size;
+    int capacity = 0;
+    int lineNumber = 0;
+
+    while (p < end) {
+        const char* newline = (const char*)memchr(p, '\n', (size_t)(end - p));
+        const char* lineEnd = newline ? newline : end;
+        const char* next = newline ? newline + 1 : end;
+        lineNumber++;
+        if (lineEnd == p || *p == '#' || *p == '\r') {
+            p = next;
+            continue;
+        }
+        if ((size_t)(lineEnd - p) < 5 || memcmp(p, "FORM ", 5) != 0) break;
+
+        if (job->formCount == capacity) {
+            capacity = capacity ? capacity * 2 : 8;
+            AnswerForm* grown = (AnswerForm*)realloc(job->forms, sizeof(AnswerForm) * capacity);
+            if (grown == NULL) return -1;
+            job->forms = grown;
+        }
+        AnswerForm* form = &job->forms[job->formCount];
+        memset(form, 0, sizeof(*form));
+        form->line = lineNumber;
+
+        char line[2048];
+        size_t length = (size_t)(lineEnd - p);
+        if (length >= sizeof(line)) length = sizeof(line) - 1;
+        memcpy(line, p, length);
+        line[length] = '\0';
+
+        char* save = NULL;
+        char* token = strtok_r(line + 5, " \t\r", &save);
+        char* idEnd = NULL;
+        errno = 0;
+        long id = token != NULL ? strtol(token, &idEnd, 10) : -1;
+        if (token == NULL || *idEnd != '\0' || !isdigit((unsigned char)*token) || errno == ERANGE || id > INT_MAX) {
+            printf("Line %d: bad form id %s\n", lineNumber, token != NULL ? token : "(missing)");
+            return -1;
+        }
+        form->id = (int)id;
+        float difficultySum = 0.0f;
+        while ((token = strtok_r(NULL, " \t\r", &save)) != NULL) {
+            errno = 0;
+            long long questionId = strtoll(token, &idEnd, 10);
+            if (*idEnd != '\0' || errno == ERANGE) {
+                printf("Line %d: bad question id %s\n", lineNumber, token);
+                return -1;
+            }
+            Question* q = getQuestionById(questionId);
+            if (q == NULL || form->length == MAX_EXAM_QUESTIONS) {
+                printf("Line %d: form %d %s\n", lineNumber, form->id,
+                       q == NULL ? "names an unknown question id" : "has too many questions");
+                return -1;
+            }
+            int answer = q->correctAnswer - 'A';
+            form->keyLow |= (uint64_t)(answer & 1) << form->length;
+            form->keyHigh |= (uint64_t)(answer >> 1) << form->length;
+            form->slots[form->length++] = (int)(q - questions);
+            difficultySum += q->difficulty;
+        }
+        if (form->length == 0) {
+            printf("Line %d: form %d has no questions\n", lineNumber, form->id);
+            return -1;
+        }
+        form->mask = form->length == 64 ? ~0ULL : (1ULL << form->length) - 1;
+        form->averageDifficulty = difficultySum / form->length;
+        job->formCount++;
+        p = next;
+    }
+
+    job->bodyStart = (size_t)(p - job->data);
+    qsort(job->forms, job->formCount, sizeof(AnswerForm), compareAnswerForms);
+    for (int f = 1; f < job->formCount; f++) {
+        if (job->forms[f].id != job->forms[f - 1].id) continue;
+        int first = job->forms[f].line < job->forms[f - 1].line ? job->forms[f].line : job->forms[f - 1].line;
+        int again = job->forms[f].line + job->forms[f - 1].line - first;
+        printf("Line %d: form %d is already defined on line %d\n", again, job->forms[f].id, first);
+        return -1;
+    }
+    return job->formCount > 0 ? 0 : -1;
+}
+
+const AnswerForm* findAnswerForm(const GradeJob* job, int id) {
+    int low = 0, high = job->formCount - 1;
+    while (low <= high) {
+        int mid = low + (high - low) / 2;
+        if (job->forms[mid].id == id) return &job->forms[mid];
+        if (job->forms[mid].id < id) low = mid + 1;
+        else high = mid - 1;
+    }
+    return NULL;
+}
+
+// Grades one sheet line; returns 0 if the sheet is malformed
+int gradeSheet(GradeJob* job, GradeWorker* worker, const char* line, const char* end) {
+    int formId = 0;
+    const char* p = line;
+    if (p == end || !isdigit((unsigned char)*p)) return 0;
+    while (p < end && isdigit((unsigned char)*p)) {
+        if (formId > (INT_MAX - (*p - '0')) / 10) return 0;  // no form has an id this large
+        formId = formId * 10 + (*p++ - '0');
+    }
+    while (p < end && (*p == ' ' || *p == '\t')) p++;
+    if (end > p && end[-1] == '\r') end--;
+
+    const AnswerForm* form = findAnswerForm(job, formId);
+    if (form == NULL || end - p != form->length) return 0;
+
+    uint64_t low = 0, high = 0, answered = 0;
+    for (int i = 0; i < form->length; i++) {
+        int answer = toupper((unsigned char)p[i]) - 'A';
+        if (answer >= 0 && answer <= 3) {
+            low |= (uint64_t)(answer & 1) << i;
+            high |= (uint64_t)(answer >> 1) << i;
+            answered |= 1ULL << i;
+        } else if (p[i] != 'S' && p[i] != 's' && p[i] != '-') {
+            return 0;
+        }
+    }
+
+    uint64_t right = ~((low ^ form->keyLow) | (high ^ form->keyHigh)) & answered & form->mask;
+    int correct = __builtin_popcountll(right);
+    int blanks = form->length - __builtin_popcountll(answered);
+
+    long long* attempts = worker->attempts + (form - job->forms) * MAX_EXAM_QUESTIONS;
+    long long* corrects = worker->correct + (form - job->forms) * MAX_EXAM_QUESTIONS;
+    for (uint64_t bits = answered; bits != 0; bits &= bits - 1) attempts[__builtin_ctzll(bits)]++;
+    for (uint64_t bits = right; bits != 0; bits &= bits - 1) corrects[__builtin_ctzll(bits)]++;
+
+    worker->itemsGraded += form->length;
+    ExamRecord* record = &worker->records[worker->recordCount++];
+    memset(record, 0, sizeof(*record));
+    record->finishedAt = job->finishedAt;
+    record->totalQuestions = form->length;
+    record->correctAnswers = correct;
+    record->wrongAnswers = form->length - correct;
+    record->skippedQuestions = blanks;
+    record->averageDifficulty = form->averageDifficulty;
+    if (worker->recordCount == GRADE_RECORD_BATCH) {
+        appendExamRecords(worker->records, worker->recordCount);
+        worker->recordCount = 0;
+    }
+
+    // A sheet's responses go out together, so exams stay contiguous in the log
+    if (responseFd < 0) return 1;
+    if (worker->responseCount + form->length > GRADE_RESPONSE_BATCH) {
+        appendResponses(worker->responses, worker->responseCount);
+        worker->responseCount = 0;
+    }
+    for (int i = 0; i < form->length; i++) {
+        ResponseRecord* r = &worker->responses[worker->responseCount++];
+        memset(r, 0, sizeof(*r));
+        r->questionId = questions[form->slots[i]].id;
+        r->formId = (uint32_t)form->id;
+        r->examCorrect = (uint16_t)correct;
+        r->examLength = (uint16_t)form->length;
+        r->position = (uint8_t)i;
+        r->answer = (answered >> i) & 1 ? (uint8_t)(((low >> i) & 1) | (((high >> i) & 1) << 1))
+                                        : RESPONSE_SKIPPED;
+        r->isCorrect = (uint8_t)((right >> i) & 1);
+    }
+    return 1;
+}
+
+// Grades the sheets starting in one slice of the file
+static void gradeChunk(void* context, int workerIndex, int task) {
+    GradeJob* job = (GradeJob*)context;
+    GradeWorker* worker = &job->workers[workerIndex];
+    const char* base = job->data + job->bodyStart;
+    const char* end = job->data + job->size;
+    const char* p = base + (size_t)task * GRADE_CHUNK_BYTES;
+    const char* chunkEnd = (size_t)(end - p) > GRADE_CHUNK_BYTES ? p + GRADE_CHUNK_BYTES : end;
+
+    // A line belongs to the chunk its first byte falls in
+    if (p > base && p[-1] != '\n') {
+        const char* newline = (const char*)memchr(p, '\n', (size_t)(end - p));
+        p = newline ? newline + 1 : end;
+    }
+    while (p < chunkEnd) {
+        const char* newline = (const char*)memchr(p, '\n', (size_t)(end - p));
+        const char* lineEnd = newline ? newline : end;
+        if (lineEnd > p && *p != '#' && !(lineEnd - p == 1 && *p == '\r')) {
+            if (gradeSheet(job, worker, p, lineEnd)) worker->graded++;
+            else worker->rejected++;
+        }
+        p = newline ? newline + 1 : end;
+    }
+}
+
+int runBatchGrading(const char* path, int threadCount) {
+    GradeJob job;
+    memset(&job, 0, sizeof(job));
+    job.data = mapFile(path, &job.size);
+    if (job.data == NULL) {
+        printf("Cannot open answer sheet file: %s\n", path);
+        return -1;
+    }
+    if (loadAnswerForms(&job) != 0) {
+        printf("%s must start with at least one valid FORM line, each form id defined once\n", path);
+        unmapFile((char*)job.data, job.size);
+        free(job.forms);
+        return -1;
+    }
+#if !defined(_WIN32)
+    madvise((char*)job.data, job.size, MADV_SEQUENTIAL);
+#endif
+
+    if (threadCount <= 0) threadCount = hardwareThreads();
+    int chunkCount = (int)((job.size - job.bodyStart + GRADE_CHUNK_BYTES - 1) / GRADE_CHUNK_BYTES);
+    if (threadCount > chunkCount && chunkCount > 0) threadCount = chunkCount;
+    size_t countersSize = sizeof(long long) * (size_t)job.formCount * MAX_EXAM_QUESTIONS;
+    job.workers = (GradeWorker*)calloc(threadCount, sizeof(GradeWorker));
+    job.finishedAt = (uint64_t)time(NULL);
+    int allocated = job.workers != NULL;
+    for (int w = 0; allocated && w < threadCount; w++) {
+        GradeWorker* worker = &job.workers[w];
+        worker->attempts = (long long*)calloc(1, countersSize);
+        worker->correct = (long long*)calloc(1, countersSize);
+        worker->records = (ExamRecord*)malloc(sizeof(ExamRecord) * GRADE_RECORD_BATCH);
+        worker->responses = (ResponseRecord*)malloc(sizeof(ResponseRecord) * GRADE_RESPONSE_BATCH);
+        allocated = worker->attempts != NULL && worker->correct != NULL && worker->records != NULL &&
+                    worker->responses != NULL;
+    }
+    if (!allocated) {
+        printf("Out of memory grading %s on %d thread(s)\n", path, threadCount);
+        for (int w = 0; job.workers != NULL && w < threadCount; w++) {
+            free(job.workers[w].attempts);
+            free(job.workers[w].correct);
+            free(job.workers[w].records);
+            free(job.workers[w].responses);
+        }
+        free(job.workers);
+        free(job.forms);
+        unmapFile((char*)job.data, job.size);
+        return -1;
+    }
+
+    uint64_t start = monotonicNs();
+    parallelFor(threadCount, chunkCount, gradeChunk, &job);
+
+    // Merge the per-thread counters into the bank
+    long long graded = 0, rejected = 0, correctTotal = 0, itemTotal = 0;
+    for (int w = 0; w < threadCount; w++) {
+        GradeWorker* worker = &job.workers[w];
+        if (worker->recordCount > 0) appendExamRecords(worker->records, worker->recordCount);
+        appendResponses(worker->responses, worker->responseCount);
+        graded += worker->graded;
+        rejected += worker->rejected;
+        itemTotal += worker->itemsGraded;
+        for (int f = 0; f < job.formCount; f++) {
+            for (int i = 0; i < job.forms[f].length; i++) {
+                int slot = job.forms[f].slots[i];
+                int d = questionDifficulty[slot];
+                long long attempts = worker->attempts[f * MAX_EXAM_QUESTIONS + i];
+                long long correct = worker->correct[f * MAX_EXAM_QUESTIONS + i];
+                atomic_fetch_add_explicit(&questionAttempts[slot], (int)attempts, memory_order_relaxed);
+                atomic_fetch_add_explicit(&questionCorrect[slot], (int)correct, memory_order_relaxed);
+                if (d >= 1 && d <= 3) {
+                    atomic_fetch_add_explicit(&aggregates.attempts[d], attempts, memory_order_relaxed);
+                    atomic_fetch_add_explicit(&aggregates.correct[d], correct, memory_order_relaxed);
+                }
+                correctTotal += correct;
+            }
+        }
+        free(worker->attempts);
+        free(worker->correct);
+        free(worker->records);
+        free(worker->responses);
+    }
+    uint64_t elapsed = monotonicNs() - start;
+
+    double seconds = elapsed / 1e9;
+    printf("Graded %lld sheet(s) from %s in %.3f s on %d thread(s) (%.0f sheets/sec)\n",
+           graded, path, seconds, threadCount, seconds > 0 ? graded / seconds : 0.0);
+    if (rejected > 0) printf("%lld malformed sheet(s) skipped\n", rejected);
+    if (itemTotal > 0) {
+        printf("Average score: %.2f%% over %d form(s)\n", correctTotal * 100.0 / itemTotal, job.formCount);
+    }
+
+    free(job.workers);
+    free(job.forms);
+    unmapFile((char*)job.data, job.size);
+    return 0;
+}
+
+// Item Analysis
+// Classical item statistics over the response log: the p-value (share
+// correct), the point-biserial correlation between answering correctly and
+// the rest of the exam score, and how often each option was chosen. The
+// log is mapped and cut into slices of ITEM_CHUNK_RECORDS; each thread sums
+// its slices into its own per-slot arrays, so nothing is shared until the
+// end. The per-thread arrays are then merged and turned into statistics in
+// ranges of bank slots, again one range per task. Both passes touch every
+// record or slot once, so the run is bound by reading the log.
+
+static void accumulateItemChunk(void* context, int workerIndex, int task) {
+    ItemAnalysisJob* job = (ItemAnalysisJob*)context;
+    ItemWorker* w = &job->workers[workerIndex];
+    long long first = (long long)task * ITEM_CHUNK_RECORDS;
+    long long last = first + ITEM_CHUNK_RECORDS < job->recordCount ? first + ITEM_CHUNK_RECORDS
+                                                                   : job->recordCount;
+    int slots[256];
+
+    // Id lookups for a block are independent, so their cache misses overlap;
+    // the sums are then added with no branches
+    for (long long block = first; block < last; block += 256) {
+        int count = last - block < 256 ? (int)(last - block) : 256;
+        const ResponseRecord* records = job->records + block;
+        for (int i = 0; i < count; i++) slots[i] = findQuestionSlot(records[i].questionId);
+        for (int i = 0; i < count; i++) {
+            const ResponseRecord* r = &records[i];
+            int slot = slots[i];
+            if (slot < 0) {
+                w->unmatched++;
+                continue;
+            }
+            long long correct = r->isCorrect != 0;
+            long long rest = (long long)r->examCorrect - correct;
+            int answer = r->answer < RESPONSE_SKIPPED ? r->answer : RESPONSE_SKIPPED;
+            w->exams += r->position == 0;
+            w->responses[slot]++;
+            w->correct[slot] += correct;
+            w->restSum[slot] += rest;
+            w->restSquares[slot] += rest * rest;
+            w->correctRestSum[slot] += rest & -correct;
+            w->options[(size_t)answer * job->slotCount + slot]++;
+        }
+    }
+}
+
+static void addItemCounts(long long* into, const long long* from, int first, int last) {
+    for (int i = first; i < last; i++) into[i] += from[i];
+}
+
+// Folds every thread's sums for one range of slots into worker 0 and
+// computes the statistics of the range
+static void mergeItemSlots(void* context, int workerIndex, int task) {
+    ItemAnalysisJob* job = (ItemAnalysisJob*)context;
+    ItemWorker* total = &job->workers[0];
+    int first = task * ITEM_MERGE_SLOTS;
+    int last = first + ITEM_MERGE_SLOTS < job->slotCount ? first + ITEM_MERGE_SLOTS : job->slotCount;
+    (void)workerIndex;
+
+    for (int w = 1; w < job->workerCount; w++) {
+        const ItemWorker* part = &job->workers[w];
+        addItemCounts(total->responses, part->responses, first, last);
+        addItemCounts(total->correct, part->correct, first, last);
+        addItemCounts(total->restSum, part->restSum, first, last);
+        addItemCounts(total->restSquares, part->restSquares, first, last);
+        addItemCounts(total->correctRestSum, part->correctRestSum, first, last);
+        for (int o = 0; o <= RESPONSE_SKIPPED; o++) {
+            size_t offset = (size_t)o * job->slotCount;
+            addItemCounts(total->options + offset, part->options + offset, first, last);
+        }
+    }
+
+    for (int i = first; i < last; i++) {
+        ItemStatistics* item = &job->items[i];
+        long long n = total->responses[i];
+        memset(item, 0, sizeof(*item));
+        item->responses = n;
+        if (n == 0) continue;
+        double p = (double)total->correct[i] / n;
+        double restMean = (double)total->restSum[i] / n;
+        double restVariance = (double)total->restSquares[i] / n - restMean * restMean;
+        double covariance = (double)total->correctRestSum[i] / n - p * restMean;
+        double spread = sqrt(p * (1.0 - p) * restVariance);
+        item->pValue = p;
+        item->discrimination = spread > 1e-12 ? covariance / spread : 0.0;
+        for (int o = 0; o <= RESPONSE_SKIPPED; o++) {
+            item->optionShare[o] = (double)total->options[(size_t)o * job->slotCount + i] / n;
+        }
+    }
+}
+
+static void printItemStatistics(const Question* q, const ItemStatistics* item) {
+    static const char* difficultyNames[4] = {"?", "Easy", "Medium", "Hard"};
+    int d = q->difficulty >= 1 && q->difficulty <= 3 ? q->difficulty : 0;
+    printf("Q%lld (%s): p %.2f  r %+.2f  n %lld |", q->id, difficultyNames[d],
+           item->pValue, item->discrimination, item->responses);
+    for (int o = 0; o < 4; o++) {
+        printf(" %c%c %.1f%%", 'A' + o, q->correctAnswer == 'A' + o ? '*' : ' ',
+               item->optionShare[o] * 100.0);
+    }
+    printf("  skipped %.1f%%\n", item->optionShare[RESPONSE_SKIPPED] * 100.0);
+}
+
+// Writes every item's statistics as tab-separated values
+static int writeItemReport(const char* path, const ItemStatistics* items) {
+    FILE* out = fopen(path, "w");
+    if (out == NULL) {
+        printf("Cannot write item report: %s\n", path);
+        return -1;
+    }
+    fprintf(out, "id\tdifficulty\tkey\tresponses\tp_value\tpoint_biserial\tA\tB\tC\tD\tskipped\n");
+    for (int i = 0; i < questionCount; i++) {
+        const ItemStatistics* item = &items[i];
+        fprintf(out, "%lld\t%d\t%c\t%lld\t%.4f\t%.4f\t%.4f\t%.4f\t%.4f\t%.4f\t%.4f\n",
+                questions[i].id, questionDifficulty[i], questions[i].correctAnswer, item->responses,
+                item->pValue, item->discrimination, item->optionShare[0], item->optionShare[1],
+                item->optionShare[2], item->optionShare[3], item->optionShare[RESPONSE_SKIPPED]);
+    }
+    if (fclose(out) != 0) {
+        printf("Cannot write item report: %s\n", path);
+        return -1;
+    }
+    printf("Item report written to %s\n", path);
+    return 0;
+}
+
+int runItemAnalysis(const char* path, int threadCount, const char* reportPath) {
+    ItemAnalysisJob job;
+    size_t size = 0;
+    memset(&job, 0, sizeof(job));
+    if (questionCount == 0) {
+        printf("No questions in bank.\n");
+        return -1;
+    }
+    char* data = mapFile(path, &size);
+    const HistoryHeader* header = (const HistoryHeader*)data;
+    if (data == NULL || size < sizeof(HistoryHeader) ||
+        memcmp(header->magic, RESPONSE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != RESPONSE_VERSION || header->recordSize != sizeof(ResponseRecord)) {
+        printf("%s is not an exam response log (or has an unsupported version)\n", path);
+        if (data != NULL) unmapFile(data, size);
+        return -1;
+    }
+#if !defined(_WIN32)
+    madvise(data, size, MADV_SEQUENTIAL);
+#endif
+    job.records = (const ResponseRecord*)(data + sizeof(HistoryHeader));
+    job.recordCount = (long long)((size - sizeof(HistoryHeader)) / sizeof(ResponseRecord));
+    job.slotCount = questionCount;
+
+    if (threadCount <= 0) threadCount = hardwareThreads();
+    int chunkCount = (int)((job.recordCount + ITEM_CHUNK_RECORDS - 1) / ITEM_CHUNK_RECORDS);
+    int mergeCount = (job.slotCount + ITEM_MERGE_SLOTS - 1) / ITEM_MERGE_SLOTS;
+    if (threadCount > chunkCount) threadCount = chunkCount > 0 ? chunkCount : 1;
+    job.workerCount = threadCount;
+    job.workers = (ItemWorker*)calloc(threadCount, sizeof(ItemWorker));
+    job.items = (ItemStatistics*)malloc(sizeof(ItemStatistics) * (size_t)job.slotCount);
+    int allocated = job.workers != NULL && job.items != NULL;
+    for (int w = 0; allocated && w < threadCount; w++) {
+        ItemWorker* worker = &job.workers[w];
+        size_t slots = (size_t)job.slotCount;
+        worker->responses = (long long*)calloc(slots, sizeof(long long));
+        worker->correct = (long long*)calloc(slots, sizeof(long long));
+        worker->restSum = (long long*)calloc(slots, sizeof(long long));
+        worker->restSquares = (long long*)calloc(slots, sizeof(long long));
+        worker->correctRestSum = (long long*)calloc(slots, sizeof(long long));
+        worker->options = (long long*)calloc(slots * (RESPONSE_SKIPPED + 1), sizeof(long long));
+        allocated = worker->responses != NULL && worker->correct != NULL && worker->restSum != NULL &&
+                    worker->restSquares != NULL && worker->correctRestSum != NULL && worker->options != NULL;
+    }
+
+    int status = allocated ? 0 : -1;
+    if (!allocated) {
+        printf("Not enough memory for item analysis on %d thread(s)\n", threadCount);
+    } else {
+        uint64_t start = monotonicNs();
+        parallelFor(threadCount, chunkCount, accumulateItemChunk, &job);
+        parallelFor(threadCount, mergeCount, mergeItemSlots, &job);
+        double seconds = (monotonicNs() - start) / 1e9;
+
+        long long unmatched = 0, exams = 0;
+        for (int w = 0; w < threadCount; w++) {
+            unmatched += job.workers[w].unmatched;
+            exams += job.workers[w].exams;
+        }
+
+        // Summary over the items with enough responses, and the least
+        // discriminating of them in ascending order
+        int answeredItems = 0, reliableItems = 0, flagged = 0;
+        double pSum = 0.0, discriminationSum = 0.0;
+        int review[ITEM_REVIEW_SHOWN];
+        int reviewCount = 0;
+        for (int i = 0; i < job.slotCount; i++) {
+            const ItemStatistics* item = &job.items[i];
+            if (item->responses > 0) answeredItems++;
+            if (item->responses < ITEM_MIN_RESPONSES) continue;
+            reliableItems++;
+            pSum += item->pValue;
+            discriminationSum += item->discrimination;
+            if (item->discrimination >= ITEM_LOW_DISCRIMINATION) continue;
+            flagged++;
+            int k = reviewCount < ITEM_REVIEW_SHOWN ? reviewCount++ : ITEM_REVIEW_SHOWN;
+            while (k > 0 && job.items[review[k - 1]].discrimination > item->discrimination) {
+                if (k < ITEM_REVIEW_SHOWN) review[k] = review[k - 1];
+                k--;
+            }
+            if (k < ITEM_REVIEW_SHOWN) review[k] = i;
+        }
+
+        printf("\n===========================================\n");
+        printf("          ITEM ANALYSIS\n");
+        printf("===========================================\n");
+        printf("Responses: %lld from %lld exam(s) in %s\n", job.recordCount, exams, path);
+        if (unmatched > 0) printf("Responses to questions not in the bank: %lld\n", unmatched);
+        printf("Analysed in %.3f s on %d thread(s) (%.0f responses/sec)\n", seconds, threadCount,
+               seconds > 0 ? job.recordCount / seconds : 0.0);
+        printf("Items answered: %d of %d\n", answeredItems, job.slotCount);
+        if (reliableItems > 0) {
+            printf("Mean p-value: %.3f  Mean point-biserial: %.3f (%d item(s) with %d+ responses)\n",
+                   pSum / reliableItems, discriminationSum / reliableItems, reliableItems,
+                   ITEM_MIN_RESPONSES);
+        }
+        printf("\nItems to review (point-biserial below %.2f): %d\n", ITEM_LOW_DISCRIMINATION, flagged);
+        for (int k = 0; k < reviewCount; k++) {
+            printItemStatistics(&questions[review[k]], &job.items[review[k]]);
+        }
+        printf("===========================================\n");
+        if (reportPath != NULL) status = writeItemReport(reportPath, job.items);
+    }
+
+    for (int w = 0; job.workers != NULL && w < threadCount; w++) {
+        ItemWorker* worker = &job.workers[w];
+        free(worker->responses);
+        free(worker->correct);
+        free(worker->restSum);
+        free(worker->restSquares);
+        free(worker->correctRestSum);
+        free(worker->options);
+    }
+    free(job.workers);
+    free(job.items);
+    unmapFile(data, size);
+    return status;
+}
+
+// Collusion Check
+// Looks for pairs of candidates whose answers agree more than chance
+// allows, counting identical wrong answers: items both got wrong with the
+// same option. This is the K-index idea: the chance that candidate B
+// matches one of A's wrong answers is the share of candidates with as many
+// wrong answers as B who gave that very answer, so weak candidates, who
+// miss the same hard items anyway, are compared with their peers and not
+// with the whole cohort. Only exams on the same paper form can be compared
+// item by item, so graded sheets are blocked by form (adaptive sessions
+// have no common form and are left out).
+//
+// Each exam is packed into bit planes like a graded sheet, so the matches
+// of a pair are a few XOR/AND operations and one popcount. For every exam
+// and every possible wrong count of its partner, the expected matches and
+// their variance are worked out once; a pair then needs one table lookup
+// per direction (A as the source, then B). Only pairs at least
+// COLLUSION_SCREEN_Z standard deviations above the expectation get the
+// exact (Poisson-binomial) chance of their matches. Each form is cut into
+// tiles of COLLUSION_TILE exams and every pair of tiles is one parallel
+// task; the threads keep their most suspicious pairs in small heaps. A
+// pair is flagged when its chance is below 10^-COLLUSION_ALPHA_DIGITS
+// divided by the number of tests (two directions per pair).
+
+static int compareCollusionExams(const void* a, const void* b) {
+    const CollusionExam* x = (const CollusionExam*)a;
+    const CollusionExam* y = (const CollusionExam*)b;
+    if (x->formId != y->formId) return x->formId < y->formId ? -1 : 1;
+    if (x->length != y->length) return x->length < y->length ? -1 : 1;
+    return x->number < y->number ? -1 : x->number > y->number;
+}
+
+static void encodeCollusionExams(void* context, int workerIndex, int task) {
+    CollusionJob* job = (CollusionJob*)context;
+    int first = task * COLLUSION_ENCODE_EXAMS;
+    int last = first + COLLUSION_ENCODE_EXAMS < job->examCount ? first + COLLUSION_ENCODE_EXAMS : job->examCount;
+    (void)workerIndex;
+
+    for (int e = first; e < last; e++) {
+        const ResponseRecord* r = job->records + job->exams[e].firstRecord;
+        uint64_t low = 0, high = 0, answered = 0, wrong = 0;
+        for (int i = 0; i < job->exams[e].length; i++) {
+            if (r[i].answer >= RESPONSE_SKIPPED) continue;
+            low |= (uint64_t)(r[i].answer & 1) << i;
+            high |= (uint64_t)(r[i].answer >> 1) << i;
+            answered |= 1ULL << i;
+            wrong |= (uint64_t)(r[i].isCorrect == 0) << i;
+        }
+        job->low[e] = low;
+        job->high[e] = high;
+        job->answered[e] = answered;
+        job->wrong[e] = wrong;
+        job->wrongCount[e] = (unsigned char)__builtin_popcountll(wrong);
+    }
+}
+
+static int collusionOption(const CollusionJob* job, int e, int item) {
+    return (int)((job->low[e] >> item) & 1) | (int)((job->high[e] >> item) & 1) << 1;
+}
+
+// Fills the block's chance table. Candidates are grouped by their number
+// of wrong answers; a group smaller than COLLUSION_PEER_GROUP borrows the
+// neighbouring counts until it is big enough. Shares are smoothed (one
+// pseudo-count spread over the options), so no answer is ever impossible.
+static void prepareCollusionBlock(void* context, int workerIndex, int b) {
+    CollusionJob* job = (CollusionJob*)context;
+    CollusionBlock* block = &job->blocks[b];
+    int length = block->length;
+    size_t cells = (size_t)(length + 1) * length * 4;
+    long long* counts = (long long*)calloc(cells + 2 * (length + 1), sizeof(long long));
+    (void)workerIndex;
+    if (counts == NULL) {
+        // Without a table every answer counts as certain to match; nothing is flagged
+        for (size_t c = 0; c < (size_t)(MAX_EXAM_QUESTIONS + 1) * MAX_EXAM_QUESTIONS * 4; c++) block->chance[c] = 1.0f;
+        return;
+    }
+    long long* peers = counts + cells;       // candidates by wrong count
+    long long* window = peers + length + 1;  // scratch for one group's shares
+
+    for (int e = block->first; e < block->first + block->count; e++) {
+        int w = job->wrongCount[e];
+        peers[w]++;
+        for (uint64_t bits = job->answered[e]; bits != 0; bits &= bits - 1) {
+            int i = __builtin_ctzll(bits);
+            counts[((size_t)w * length + i) * 4 + collusionOption(job, e, i)]++;
+        }
+    }
+    for (int w = 0; w <= length; w++) {
+        int lo = w, hi = w;
+        long long group = peers[w];
+        while (group < COLLUSION_PEER_GROUP && (lo > 0 || hi < length)) {
+            if (lo > 0) group += peers[--lo];
+            if (hi < length) group += peers[++hi];
+        }
+        for (int i = 0; i < length; i++) {
+            for (int o = 0; o < 4; o++) {
+                long long chosen = 0;
+                for (int v = lo; v <= hi; v++) chosen += counts[((size_t)v * length + i) * 4 + o];
+                window[o] = chosen;
+            }
+            for (int o = 0; o < 4; o++) {
+                block->chance[((size_t)w * MAX_EXAM_QUESTIONS + i) * 4 + o] =
+                    (float)((window[o] + 0.25) / (group + 1.0));
+            }
+        }
+    }
+    free(counts);
+}
+
+// Expected chance matches of each exam's wrong answers, for every wrong
+// count its partner may have
+static void expectCollusionMatches(void* context, int workerIndex, int task) {
+    CollusionJob* job = (CollusionJob*)context;
+    int first = task * COLLUSION_ENCODE_EXAMS;
+    int last = first + COLLUSION_ENCODE_EXAMS < job->examCount ? first + COLLUSION_ENCODE_EXAMS : job->examCount;
+    (void)workerIndex;
+
+    for (int e = first; e < last; e++) {
+        const CollusionBlock* block = &job->blocks[job->exams[e].block];
+        uint32_t* expected = job->expected + (size_t)e * (MAX_EXAM_QUESTIONS + 1);
+        for (int w = 0; w <= block->length; w++) {
+            const float* chance = block->chance + (size_t)w * MAX_EXAM_QUESTIONS * 4;
+            double mean = 0.0, variance = 0.0;
+            for (uint64_t bits = job->wrong[e]; bits != 0; bits &= bits - 1) {
+                int i = __builtin_ctzll(bits);
+                double p = chance[i * 4 + collusionOption(job, e, i)];
+                mean += p;
+                variance += p * (1.0 - p);
+            }
+            expected[w] = (uint32_t)lround(mean * COLLUSION_FIXED_ONE) << 16 |
+                          (uint32_t)lround(variance * COLLUSION_FIXED_ONE);
+        }
+    }
+}
+
+// -log10 of the chance that a partner with partnerWrong wrong answers
+// matches at least matches of the source's wrong answers, each one
+// independently with its peer share
+static float collusionSurprise(const CollusionJob* job, int source, int partnerWrong, int matches) {
+    const CollusionBlock* block = &job->blocks[job->exams[source].block];
+    const float* chance = block->chance + (size_t)partnerWrong * MAX_EXAM_QUESTIONS * 4;
+    double distribution[MAX_EXAM_QUESTIONS + 1] = {1.0};
+    int n = 0;
+    for (uint64_t bits = job->wrong[source]; bits != 0; bits &= bits - 1) {
+        int i = __builtin_ctzll(bits);
+        double p = chance[i * 4 + collusionOption(job, source, i)];
+        n++;
+        distribution[n] = 0.0;
+        for (int j = n; j > 0; j--) distribution[j] = distribution[j] * (1.0 - p) + distribution[j - 1] * p;
+        distribution[0] *= 1.0 - p;
+    }
+    double tail = 0.0;
+    for (int j = matches; j <= n; j++) tail += distribution[j];
+    return tail > 1e-300 ? (float)-log10(tail) : 300.0f;
+}
+
+// Adds a pair to the worker's heap of the topLimit most suspicious pairs
+static void keepCollusionPair(CollusionWorker* w, int topLimit, const CollusionPair* pair) {
+    int i;
+    if (w->topCount < topLimit) {
+        i = w->topCount++;
+        while (i > 0 && w->top[(i - 1) / 2].surprise > pair->surprise) {
+            w->top[i] = w->top[(i - 1) / 2];
+            i = (i - 1) / 2;
+        }
+    } else {
+        i = 0;
+        for (;;) {
+            int child = 2 * i + 1;
+            if (child >= topLimit) break;
+            if (child + 1 < topLimit && w->top[child + 1].surprise < w->top[child].surprise) child++;
+            if (w->top[child].surprise >= pair->surprise) break;
+            w->top[i] = w->top[child];
+            i = child;
+        }
+    }
+    w->top[i] = *pair;
+}
+
+// Screens the matches against one direction's expectation
+static int collusionScreen(uint32_t expected, int matches) {
+    int64_t excess = (int64_t)matches * COLLUSION_FIXED_ONE - (int64_t)(expected >> 16);
+    int64_t screen = (int64_t)(COLLUSION_SCREEN_Z * COLLUSION_SCREEN_Z * COLLUSION_FIXED_ONE);
+    return excess > 0 && excess * excess >= screen * (int64_t)(expected & 0xFFFF);
+}
+
+// Compares every exam of one tile with every exam of another
+static void compareCollusionTiles(void* context, int workerIndex, int t) {
+    CollusionJob* job = (CollusionJob*)context;
+    CollusionWorker* w = &job->workers[workerIndex];
+    const CollusionTask* task = &job->tasks[t];
+    const CollusionBlock* block = &job->blocks[task->block];
+    int blockEnd = block->first + block->count;
+    int rowStart = block->first + task->rowTile * COLLUSION_TILE;
+    int rowEnd = rowStart + COLLUSION_TILE < blockEnd ? rowStart + COLLUSION_TILE : blockEnd;
+    int columnStart = block->first + task->columnTile * COLLUSION_TILE;
+    int columnEnd = columnStart + COLLUSION_TILE < blockEnd ? columnStart + COLLUSION_TILE : blockEnd;
+    const uint64_t* low = job->low;
+    const uint64_t* high = job->high;
+    const uint64_t* wrong = job->wrong;
+    const unsigned char* wrongCount = job->wrongCount;
+    const uint32_t* expected = job->expected;
+
+    for (int a = rowStart; a < rowEnd; a++) {
+        uint64_t lowA = low[a], highA = high[a], wrongA = wrong[a];
+        const uint32_t* expectedA = expected + (size_t)a * (MAX_EXAM_QUESTIONS + 1);
+        int first = task->rowTile == task->columnTile ? a + 1 : columnStart;
+        w->compared += columnEnd - first;
+        for (int b = first; b < columnEnd; b++) {
+            uint64_t sameWrong = wrongA & wrong[b] & ~((lowA ^ low[b]) | (highA ^ high[b]));
+            int matches = __builtin_popcountll(sameWrong);
+            int fromA = collusionScreen(expectedA[wrongCount[b]], matches);
+            int fromB = collusionScreen(expected[(size_t)b * (MAX_EXAM_QUESTIONS + 1) + wrongCount[a]], matches);
+            if (!fromA && !fromB) continue;
+
+            CollusionPair pair = {a, b, a, 0.0f};
+            if (fromA) pair.surprise = collusionSurprise(job, a, wrongCount[b], matches);
+            if (fromB) {
+                float s = collusionSurprise(job, b, wrongCount[a], matches);
+                if (s > pair.surprise) {
+                    pair.surprise = s;
+                    pair.source = b;
+                }
+            }
+            w->flagged += pair.surprise >= job->flagSurprise;
+            if (w->topCount == job->topLimit && pair.surprise <= w->top[0].surprise) continue;
+            keepCollusionPair(w, job->topLimit, &pair);
+        }
+    }
+}
+
+static int compareCollusionPairs(const void* a, const void* b) {
+    const CollusionPair* x = (const CollusionPair*)a;
+    const CollusionPair* y = (const CollusionPair*)b;
+    if (x->surprise != y->surprise) return x->surprise > y->surprise ? -1 : 1;
+    if (x->a != y->a) return x->a < y->a ? -1 : 1;
+    return x->b < y->b ? -1 : x->b > y->b;
+}
+
+// Counts behind one reported pair
+static void describeCollusionPair(const CollusionJob* job, const CollusionPair* pair, int* identical,
+                                  int* sameWrong, double* expectedMatches) {
+    int a = pair->a, b = pair->b;
+    int partner = pair->source == a ? b : a;
+    uint64_t differ = (job->low[a] ^ job->low[b]) | (job->high[a] ^ job->high[b]);
+    uint32_t expected = job->expected[(size_t)pair->source * (MAX_EXAM_QUESTIONS + 1) + job->wrongCount[partner]];
+    *identical = __builtin_popcountll(job->answered[a] & job->answered[b] & ~differ);
+    *sameWrong = __builtin_popcountll(job->wrong[a] & job->wrong[b] & ~differ);
+    *expectedMatches = (double)(expected >> 16) / COLLUSION_FIXED_ONE;
+}
+
+// Writes the reported pairs as tab-separated values
+static int writeCollusionReport(const char* path, const CollusionJob* job, const CollusionPair* pairs, int count) {
+    FILE* out = fopen(path, "w");
+    if (out == NULL) {
+        printf("Cannot write collusion report: %s\n", path);
+        return -1;
+    }
+    fprintf(out, "rank\texam_a\texam_b\tform\tlength\tscore_a\tscore_b\twrong_a\twrong_b\tidentical\t"
+                 "same_wrong\texpected_same_wrong\tneg_log10_p\tflagged\n");
+    for (int i = 0; i < count; i++) {
+        const CollusionExam* a = &job->exams[pairs[i].a];
+        const CollusionExam* b = &job->exams[pairs[i].b];
+        int identical, sameWrong;
+        double expectedMatches;
+        describeCollusionPair(job, &pairs[i], &identical, &sameWrong, &expectedMatches);
+        fprintf(out, "%d\t%d\t%d\t%u\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%.2f\t%.2f\t%d\n", i + 1, a->number, b->number,
+                a->formId, a->length, job->records[a->firstRecord].examCorrect,
+                job->records[b->firstRecord].examCorrect, job->wrongCount[pairs[i].a],
+                job->wrongCount[pairs[i].b], identical, sameWrong, expectedMatches, pairs[i].surprise,
+                pairs[i].surprise >= job->flagSurprise);
+    }
+    if (fclose(out) != 0) {
+        printf("Cannot write collusion report: %s\n", path);
+        return -1;
+    }
+    printf("Collusion report written to %s\n", path);
+    return 0;
+}
+
+int runCollusionCheck(const char* path, int threadCount, int topLimit, const char* reportPath) {
+    CollusionJob job;
+    size_t size = 0;
+    memset(&job, 0, sizeof(job));
+    char* data = mapFile(path, &size);
+    const HistoryHeader* header = (const HistoryHeader*)data;
+    if (data == NULL || size < sizeof(HistoryHeader) ||
+        memcmp(header->magic, RESPONSE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != RESPONSE_VERSION || header->recordSize != sizeof(ResponseRecord)) {
+        printf("%s is not an exam response log (or has an unsupported version)\n", path);
+        if (data != NULL) unmapFile(data, size);
+        return -1;
+    }
+#if !defined(_WIN32)
+    madvise(data, size, MADV_SEQUENTIAL);
+#endif
+    job.records = (const ResponseRecord*)(data + sizeof(HistoryHeader));
+    long long recordCount = (long long)((size - sizeof(HistoryHeader)) / sizeof(ResponseRecord));
+    job.topLimit = topLimit > 0 ? topLimit : COLLUSION_DEFAULT_TOP;
+    if (threadCount <= 0) threadCount = hardwareThreads();
+
+    // Find the complete exams taken on a form; an exam is its position-0
+    // record and the examLength records after it
+    uint64_t start = monotonicNs();
+    int examNumber = 0, adaptive = 0, broken = 0, capacity = 0;
+    for (long long x = 0; x < recordCount;) {
+        const ResponseRecord* r = &job.records[x];
+        if (r->position != 0) {
+            x++;
+            continue;
+        }
+        examNumber++;
+        int length = r->examLength;
+        int complete = length > 0 && length <= MAX_EXAM_QUESTIONS && x + length <= recordCount;
+        for (int i = 1; complete && i < length; i++) {
+            complete = r[i].position == i && r[i].formId == r->formId && r[i].examLength == length;
+        }
+        if (!complete) {
+            broken++;
+            x++;
+            continue;
+        }
+        x += length;
+        if (r->formId == RESPONSE_NO_FORM) {
+            adaptive++;
+            continue;
+        }
+        if (job.examCount == capacity) {
+            capacity = capacity ? capacity * 2 : 4096;
+            CollusionExam* grown = (CollusionExam*)realloc(job.exams, sizeof(CollusionExam) * capacity);
+            if (grown == NULL) break;
+            job.exams = grown;
+        }
+        CollusionExam* exam = &job.exams[job.examCount++];
+        exam->firstRecord = x - length;
+        exam->formId = r->formId;
+        exam->length = length;
+        exam->number = examNumber;
+    }
+    if (job.examCount > 0) qsort(job.exams, job.examCount, sizeof(CollusionExam), compareCollusionExams);
+
+    // One block per form (and length, should a form id have been reused)
+    for (int e = 0; e < job.examCount; e++) {
+        if (e == 0 || job.exams[e].formId != job.exams[e - 1].formId || job.exams[e].length != job.exams[e - 1].length) {
+            job.blockCount++;
+        }
+        job.exams[e].block = job.blockCount - 1;
+    }
+    size_t examSlots = (size_t)(job.examCount > 0 ? job.examCount : 1);
+    job.blocks = (CollusionBlock*)calloc(job.blockCount > 0 ? job.blockCount : 1, sizeof(CollusionBlock));
+    job.low = (uint64_t*)malloc(sizeof(uint64_t) * examSlots);
+    job.high = (uint64_t*)malloc(sizeof(uint64_t) * examSlots);
+    job.answered = (uint64_t*)malloc(sizeof(uint64_t) * examSlots);
+    job.wrong = (uint64_t*)malloc(sizeof(uint64_t) * examSlots);
+    job.wrongCount = (unsigned char*)malloc(examSlots);
+    job.expected = (uint32_t*)malloc(sizeof(uint32_t) * (MAX_EXAM_QUESTIONS + 1) * examSlots);
+    job.workers = (CollusionWorker*)calloc(threadCount, sizeof(CollusionWorker));
+    int allocated = job.blocks != NULL && job.low != NULL && job.high != NULL && job.answered != NULL &&
+                    job.wrong != NULL && job.wrongCount != NULL && job.expected != NULL && job.workers != NULL;
+    long long taskTotal = 0;
+    double pairTotal = 0.0;
+    for (int e = 0; allocated && e < job.examCount; e++) {
+        CollusionBlock* block = &job.blocks[job.exams[e].block];
+        if (block->count++ == 0) {
+            block->first = e;
+            block->length = job.exams[e].length;
+        }
+    }
+    for (int b = 0; allocated && b < job.blockCount; b++) {
+        CollusionBlock* block = &job.blocks[b];
+        long long tiles = (block->count + COLLUSION_TILE - 1) / COLLUSION_TILE;
+        taskTotal += tiles * (tiles + 1) / 2;
+        pairTotal += (double)block->count * (block->count - 1) / 2.0;
+        block->chance = (float*)malloc(sizeof(float) * (MAX_EXAM_QUESTIONS + 1) * MAX_EXAM_QUESTIONS * 4);
+        allocated = block->chance != NULL;
+    }
+    if (allocated && taskTotal > 0) {
+        job.tasks = taskTotal <= INT_MAX ? (CollusionTask*)malloc(sizeof(CollusionTask) * (size_t)taskTotal) : NULL;
+        allocated = job.tasks != NULL;
+    }
+    for (int w = 0; allocated && w < threadCount; w++) {
+        job.workers[w].top = (CollusionPair*)malloc(sizeof(CollusionPair) * job.topLimit);
+        allocated = job.workers[w].top != NULL;
+    }
+    for (int b = 0; allocated && b < job.blockCount; b++) {
+        int tiles = (job.blocks[b].count + COLLUSION_TILE - 1) / COLLUSION_TILE;
+        for (int row = 0; row < tiles; row++) {
+            for (int column = row; column < tiles; column++) {
+                CollusionTask* task = &job.tasks[job.taskCount++];
+                task->block = b;
+                task->rowTile = row;
+                task->columnTile = column;
+            }
+        }
+    }
+
+    int status = allocated ? 0 : -1;
+    if (!allocated) {
+        printf("Not enough memory to compare %d exams\n", job.examCount);
+    } else {
+        int examTasks = (job.examCount + COLLUSION_ENCODE_EXAMS - 1) / COLLUSION_ENCODE_EXAMS;
+        job.flagSurprise = (float)(COLLUSION_ALPHA_DIGITS + (pairTotal > 0.5 ? log10(2.0 * pairTotal) : 0.0));
+        parallelFor(threadCount, examTasks, encodeCollusionExams, &job);
+        parallelFor(threadCount, job.blockCount, prepareCollusionBlock, &job);
+        parallelFor(threadCount, examTasks, expectCollusionMatches, &job);
+        parallelFor(threadCount, job.taskCount, compareCollusionTiles, &job);
+        double seconds = (monotonicNs() - start) / 1e9;
+
+        // Every thread's heap holds its best pairs, so the overall best are among them
+        long long compared = 0, flagged = 0;
+        int candidates = 0;
+        for (int w = 0; w < threadCount; w++) {
+            compared += job.workers[w].compared;
+            flagged += job.workers[w].flagged;
+            candidates += job.workers[w].topCount;
+        }
+        CollusionPair* pairs = (CollusionPair*)malloc(sizeof(CollusionPair) * (candidates > 0 ? candidates : 1));
+        int pairCount = 0;
+        for (int w = 0; pairs != NULL && w < threadCount; w++) {
+            memcpy(pairs + pairCount, job.workers[w].top, sizeof(CollusionPair) * job.workers[w].topCount);
+            pairCount += job.workers[w].topCount;
+        }
+        if (pairs != NULL) qsort(pairs, pairCount, sizeof(CollusionPair), compareCollusionPairs);
+        if (pairCount > job.topLimit) pairCount = job.topLimit;
+
+        printf("\n===========================================\n");
+        printf("          COLLUSION CHECK\n");
+        printf("===========================================\n");
+        printf("Exams on paper forms: %d on %d form(s) in %s\n", job.examCount, job.blockCount, path);
+        if (adaptive > 0) printf("Adaptive exams left out (no shared form): %d\n", adaptive);
+        if (broken > 0) printf("Incomplete exams skipped: %d\n", broken);
+        printf("Pairs compared: %lld in %.3f s on %d thread(s) (%.0f pairs/sec)\n", compared, seconds,
+               threadCount, seconds > 0 ? compared / seconds : 0.0);
+        printf("Flagged pairs (chance below 1e-%.1f): %lld\n", job.flagSurprise, flagged);
+        if (pairCount > 0) printf("\nMost suspicious pairs:\n");
+        for (int i = 0; i < pairCount; i++) {
+            const CollusionExam* a = &job.exams[pairs[i].a];
+            const CollusionExam* b = &job.exams[pairs[i].b];
+            int identical, sameWrong;
+            double expectedMatches;
+            describeCollusionPair(&job, &pairs[i], &identical, &sameWrong, &expectedMatches);
+            printf("%2d. Exams %d and %d, form %u: chance 1e-%.1f%s\n", i + 1, a->number, b->number, a->formId,
+                   pairs[i].surprise, pairs[i].surprise >= job.flagSurprise ? "  [flagged]" : "");
+            printf("    Scores %d and %d of %d, %d answers identical, %d identical wrong answers (%.1f expected)\n",
+                   job.records[a->firstRecord].examCorrect, job.records[b->firstRecord].examCorrect, a->length,
+                   identical, sameWrong, expectedMatches);
+        }
+        printf("===========================================\n");
+        if (reportPath != NULL && pairs != NULL) status = writeCollusionReport(reportPath, &job, pairs, pairCount);
+        free(pairs);
+    }
+
+    for (int b = 0; job.blocks != NULL && b < job.blockCount; b++) free(job.blocks[b].chance);
+    for (int w = 0; job.workers != NULL && w < threadCount; w++) free(job.workers[w].top);
+    free(job.blocks);
+    free(job.tasks);
+    free(job.workers);
+    free(job.low);
+    free(job.high);
+    free(job.answered);
+    free(job.wrong);
+    free(job.wrongCount);
+    free(job.expected);
+    free(job.exams);
+    unmapFile(data, size);
+    return status;
+}
+
+// Near-Duplicate Detection
+// Banks merged from several authoring teams pick up reworded copies of the
+// same item. Each question is cut into shingles (pairs of adjacent words
+// within its text or one option, or the lone word of a one-word field) and
+// summarised by DEDUP_HASHES MinHash values: two questions agree on each
+// value with probability equal to the Jaccard similarity of their shingle
+// sets. Signatures are computed in parallel, DEDUP_CHUNK_SLOTS per task.
+// Locality-sensitive hashing then splits every signature into DEDUP_BANDS
+// bands; questions with an identical band share a bucket, and a question
+// is only compared with the latest members of its buckets, so the check
+// stays linear in the bank size instead of comparing every pair. With 8
+// bands of 4 values a pair at similarity 0.8 shares a bucket 98% of the
+// time; one at 0.5 does about 40% of the time and is then turned down by
+// the signature comparison. Confirmed pairs are joined with union-find.
+
+// Folds one shingle into the running minimum of every hash
+static void addShingle(const DedupJob* job, uint32_t* mins, uint32_t shingle) {
+    for (int i = 0; i < DEDUP_HASHES; i++) {
+        uint32_t value = job->hashA[i] * shingle + job->hashB[i];
+        mins[i] = value < mins[i] ? value : mins[i];
+    }
+}
+
+static void signQuestionChunk(void* context, int workerIndex, int task) {
+    DedupJob* job = (DedupJob*)context;
+    char term[SEARCH_TERM_MAX];
+    int first = task * DEDUP_CHUNK_SLOTS;
+    int last = first + DEDUP_CHUNK_SLOTS < job->slotCount ? first + DEDUP_CHUNK_SLOTS : job->slotCount;
+    (void)workerIndex;
+
+    for (int slot = first; slot < last; slot++) {
+        const Question* q = &questions[slot];
+        const TextRef fields[5] = {q->question, q->optionA, q->optionB, q->optionC, q->optionD};
+        uint32_t mins[DEDUP_HASHES];
+        int shingles = 0;
+        for (int i = 0; i < DEDUP_HASHES; i++) mins[i] = UINT32_MAX;
+
+        for (int f = 0; f < 5; f++) {
+            const char* p = textOf(fields[f]);
+            const char* end = p + fields[f].length;
+            uint64_t hash, previous = 0;
+            int words = 0;
+            while (nextSearchTerm(&p, end, term, &hash) > 0) {
+                if (words++ > 0) {
+                    addShingle(job, mins, (uint32_t)((previous * 0x9E3779B97F4A7C15ULL ^ hash) >> 32));
+                    shingles++;
+                }
+                previous = hash;
+            }
+            if (words == 1) {
+                addShingle(job, mins, (uint32_t)(previous >> 32));
+                shingles++;
+            }
+        }
+
+        // Only the low 16 bits of each minimum are kept: unlike the high
+        // bits of a minimum they are evenly spread, and two different
+        // minimums rarely share them
+        uint16_t* signature = job->signatures + (size_t)slot * DEDUP_HASHES;
+        for (int i = 0; i < DEDUP_HASHES; i++) signature[i] = (uint16_t)mins[i];
+        job->hasText[slot] = shingles > 0;
+    }
+}
+
+// The DEDUP_ROWS values of one band, read as a single key
+static uint64_t bandKey(const DedupJob* job, int slot, int band) {
+    uint64_t key;
+    memcpy(&key, job->signatures + (size_t)slot * DEDUP_HASHES + band * DEDUP_ROWS, sizeof(key));
+    return key;
+}
+
+static int signatureMatches(const uint16_t* a, const uint16_t* b) {
+    int matches = 0;
+    for (int i = 0; i < DEDUP_HASHES; i++) matches += a[i] == b[i];
+    return matches;
+}
+
+// Buckets every question by one band. Each bucket is a chain through the
+// worker's chains array, newest first; a question is linked to the first
+// of the DEDUP_BUCKET_COMPARE members before it that it really resembles.
+static void bucketBand(void* context, int workerIndex, int band) {
+    DedupJob* job = (DedupJob*)context;
+    int* table = job->tables + (size_t)workerIndex * job->tableSize;
+    int* chain = job->chains + (size_t)workerIndex * job->slotCount;
+    size_t mask = job->tableSize - 1;
+    size_t count = 0, capacity = 0;
+    int* edges = NULL;
+
+    memset(table, 0xFF, sizeof(int) * job->tableSize);
+    for (int slot = 0; slot < job->slotCount; slot++) {
+        if (!job->hasText[slot]) continue;
+        uint64_t key = bandKey(job, slot, band);
+        size_t i = (size_t)((key * 0x9E3779B97F4A7C15ULL) >> job->tableShift);
+        while (table[i] >= 0 && bandKey(job, table[i], band) != key) i = (i + 1) & mask;
+        chain[slot] = table[i];
+        table[i] = slot;
+
+        const uint16_t* signature = job->signatures + (size_t)slot * DEDUP_HASHES;
+        int other = chain[slot];
+        for (int k = 0; other >= 0 && k < DEDUP_BUCKET_COMPARE; k++, other = chain[other]) {
+            if (signatureMatches(signature, job->signatures + (size_t)other * DEDUP_HASHES) < job->matchesNeeded) {
+                continue;
+            }
+            if (count == capacity) {
+                capacity = capacity ? capacity * 2 : 4096;
+                int* grown = (int*)realloc(edges, sizeof(int) * 2 * capacity);
+                if (grown == NULL) {
+                    job->bandFailed[band] = 1;
+                    break;
+                }
+                edges = grown;
+            }
+            edges[2 * count] = other;
+            edges[2 * count + 1] = slot;
+            count++;
+            break;
+        }
+    }
+    job->edges[band] = edges;
+    job->edgeCounts[band] = count;
+}
+
+static int findCluster(int* parent, int slot) {
+    while (parent[slot] != slot) {
+        parent[slot] = parent[parent[slot]];
+        slot = parent[slot];
+    }
+    return slot;
+}
+
+// Writes every cluster as one line of question ids, in bank order
+static int writeClusters(const char* path, const int* root, const int* clusterSize, const int* nextMember) {
+    FILE* out = fopen(path, "w");
+    if (out == NULL) {
+        printf("Cannot write duplicate clusters: %s\n", path);
+        return -1;
+    }
+    for (int slot = 0; slot < questionCount; slot++) {
+        if (root[slot] != slot || clusterSize[slot] < 2) continue;
+        for (int m = slot; m >= 0; m = nextMember[m]) {
+            fprintf(out, m == slot ? "%lld" : " %lld", questions[m].id);
+        }
+        fputc('\n', out);
+    }
+    if (fclose(out) != 0) {
+        printf("Cannot write duplicate clusters: %s\n", path);
+        return -1;
+    }
+    printf("Duplicate clusters written to %s\n", path);
+    return 0;
+}
+
+int runDuplicateCheck(double similarity, int threadCount, const char* clustersPath) {
+    DedupJob job;
+    memset(&job, 0, sizeof(job));
+    if (questionCount == 0) {
+        printf("No questions in bank.\n");
+        return -1;
+    }
+    if (searchFold['a'] == 0) initSearchFold();
+    job.slotCount = questionCount;
+    job.matchesNeeded = (int)ceil(similarity * DEDUP_HASHES);
+    if (job.matchesNeeded < 1) job.matchesNeeded = 1;
+
+    // Fixed seeds, so a bank always gives the same clusters
+    uint64_t seed = 0x2545F4914F6CDD1DULL;
+    for (int i = 0; i < DEDUP_HASHES; i++) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        job.hashA[i] = (uint32_t)(seed >> 32) | 1;
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        job.hashB[i] = (uint32_t)(seed >> 32);
+    }
+    int tableBits = 1;
+    while (((size_t)1 << tableBits) < (size_t)job.slotCount * 2) tableBits++;
+    job.tableSize = (size_t)1 << tableBits;
+    job.tableShift = 64 - tableBits;
+
+    if (threadCount <= 0) threadCount = hardwareThreads();
+    int chunkCount = (job.slotCount + DEDUP_CHUNK_SLOTS - 1) / DEDUP_CHUNK_SLOTS;
+    int bandWorkers = threadCount < DEDUP_BANDS ? threadCount : DEDUP_BANDS;
+    size_t slots = (size_t)job.slotCount;
+    job.signatures = (uint16_t*)malloc(sizeof(uint16_t) * DEDUP_HASHES * slots);
+    job.hasText = (unsigned char*)malloc(slots);
+    job.tables = (int*)malloc(sizeof(int) * job.tableSize * bandWorkers);
+    job.chains = (int*)malloc(sizeof(int) * slots * bandWorkers);
+    int* root = (int*)malloc(sizeof(int) * slots);
+    int* clusterSize = (int*)malloc(sizeof(int) * slots);
+    int* nextMember = (int*)malloc(sizeof(int) * slots);
+    if (job.signatures == NULL || job.hasText == NULL || job.tables == NULL || job.chains == NULL ||
+        root == NULL || clusterSize == NULL || nextMember == NULL) {
+        printf("Not enough memory to check %d questions for duplicates\n", job.slotCount);
+        free(job.signatures);
+        free(job.hasText);
+        free(job.tables);
+        free(job.chains);
+        free(root);
+        free(clusterSize);
+        free(nextMember);
+        return -1;
+    }
+
+    uint64_t start = monotonicNs();
+    parallelFor(threadCount, chunkCount, signQuestionChunk, &job);
+    parallelFor(bandWorkers, DEDUP_BANDS, bucketBand, &job);
+
+    for (int i = 0; i < job.slotCount; i++) {
+        root[i] = i;
+        clusterSize[i] = 1;
+    }
+    int complete = 1;
+    for (int band = 0; band < DEDUP_BANDS; band++) {
+        complete &= !job.bandFailed[band];
+        for (size_t e = 0; e < job.edgeCounts[band]; e++) {
+            int a = findCluster(root, job.edges[band][2 * e]);
+            int b = findCluster(root, job.edges[band][2 * e + 1]);
+            if (a == b) continue;
+            // The earliest slot stays the root, so clusters list in bank order
+            if (a > b) {
+                int t = a;
+                a = b;
+                b = t;
+            }
+            root[b] = a;
+            clusterSize[a] += clusterSize[b];
+        }
+        free(job.edges[band]);
+    }
+    double seconds = (monotonicNs() - start) / 1e9;
+
+    // Member lists in bank order (built backwards), the cluster totals and
+    // the largest clusters, biggest first
+    int clusters = 0, copies = 0, wordless = 0;
+    int largest[DEDUP_CLUSTERS_SHOWN];
+    int largestCount = 0;
+    for (int i = 0; i < job.slotCount; i++) {
+        root[i] = findCluster(root, i);
+        nextMember[i] = -1;
+    }
+    for (int i = job.slotCount - 1; i >= 0; i--) {
+        int r = root[i];
+        if (r == i) continue;
+        nextMember[i] = nextMember[r];
+        nextMember[r] = i;
+    }
+    for (int i = 0; i < job.slotCount; i++) {
+        wordless += !job.hasText[i];
+        if (root[i] != i || clusterSize[i] < 2) continue;
+        clusters++;
+        copies += clusterSize[i] - 1;
+        int k = largestCount < DEDUP_CLUSTERS_SHOWN ? largestCount++ : DEDUP_CLUSTERS_SHOWN;
+        while (k > 0 && clusterSize[largest[k - 1]] < clusterSize[i]) {
+            if (k < DEDUP_CLUSTERS_SHOWN) largest[k] = largest[k - 1];
+            k--;
+        }
+        if (k < DEDUP_CLUSTERS_SHOWN) largest[k] = i;
+    }
+
+    printf("\n===========================================\n");
+    printf("          DUPLICATE CHECK\n");
+    printf("===========================================\n");
+    printf("Questions checked: %d", job.slotCount);
+    if (wordless > 0) printf(" (%d without any words, skipped)", wordless);
+    printf("\nChecked in %.3f s on %d thread(s) (%.0f questions/sec)\n", seconds, threadCount,
+           seconds > 0 ? job.slotCount / seconds : 0.0);
+    if (!complete) printf("Ran out of memory; some pairs were not recorded.\n");
+    printf("Near-duplicate clusters (similarity %.2f or more): %d, holding %d extra cop%s\n",
+           similarity, clusters, copies, copies == 1 ? "y" : "ies");
+    for (int k = 0; k < largestCount; k++) {
+        int r = largest[k];
+        const Question* q = &questions[r];
+        int shown = 0;
+        printf("\n%d questions, ids", clusterSize[r]);
+        for (int m = r; m >= 0 && shown < 8; m = nextMember[m], shown++) printf(" %lld", questions[m].id);
+        if (clusterSize[r] > shown) printf(" ...");
+        printf("\n  %.*s%s\n", q->question.length < 70 ? (int)q->question.length : 70, textOf(q->question),
+               q->question.length > 70 ? "..." : "");
+    }
+    printf("===========================================\n");
+
+    int status = complete ? 0 : -1;
+    if (clustersPath != NULL && writeClusters(clustersPath, root, clusterSize, nextMember) != 0) status = -1;
+    free(job.signatures);
+    free(job.hasText);
+    free(job.tables);
+    free(job.chains);
+    free(root);
+    free(clusterSize);
+    free(nextMember);
+    return status;
+}
+
+// Form Assembly
+// Builds many fixed paper forms at once. Each form takes the blueprint's
+// number of items per difficulty from the availability index, picking the
+// slots of each difficulty at random with a per-form generator. Items are claimed
+// with a compare-and-swap on their exposure counter, so no item ends up on
+// more forms than its cap and threads never lock. Pairwise overlap is then
+// measured through an item -> forms index; forms sharing more items than
+// allowed with an earlier form are released and rebuilt, a few rounds at
+// most. The forms are written as FORM lines that --grade reads directly.
+
+static uint64_t formRandom(uint64_t* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+// Takes one more use of a bank slot unless it is already at its cap
+static int claimFormItem(atomic_int* exposure, int cap) {
+    int used = atomic_load_explicit(exposure, memory_order_relaxed);
+    while (used < cap) {
+        if (atomic_compare_exchange_weak_explicit(exposure, &used, used + 1,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void assembleFormTask(void* context, int worker, int task) {
+    AssemblyJob* job = (AssemblyJob*)context;
+    PaperForm* form = &job->forms[task];
+    (void)worker;
+    if (job->round > 0 && !atomic_load_explicit(&job->redo[task], memory_order_relaxed)) return;
+
+    uint64_t state = hashQuestionId((long long)task * (FORM_REPAIR_ROUNDS + 1) + job->round) | 1;
+    form->length = 0;
+    for (int d = 1; d <= 3; d++) {
+        int count = difficultySlotCount[d];
+        form->counts[d] = 0;
+        if (count == 0 || job->target[d] == 0) continue;
+        // Uniform random picks keep forms independent of each other; once
+        // most items are at their cap, sweep the rest from a random point
+        int first = form->length;
+        int tries = FORM_RANDOM_TRIES * job->target[d];
+        int position = (int)(formRandom(&state) % (uint64_t)count);
+        for (int k = 0; k < tries + count && form->counts[d] < job->target[d]; k++) {
+            if (k < tries) {
+                position = (int)(formRandom(&state) % (uint64_t)count);
+            } else if (++position == count) {
+                position = 0;
+            }
+            int slot = difficultySlots[d][position];
+            int taken = 0;
+            for (int i = first; i < form->length && !taken; i++) taken = form->slots[i] == slot;
+            if (!taken && claimFormItem(&job->exposure[slot], job->exposureCap[d])) {
+                form->slots[form->length++] = slot;
+                form->counts[d]++;
+            }
+        }
+    }
+}
+
+// Overlap of one form with every other form sharing an item with it
+static void measureOverlapTask(void* context, int worker, int task) {
+    AssemblyJob* job = (AssemblyJob*)context;
+    AssemblyWorker* w = &job->workers[worker];
+    const PaperForm* form = &job->forms[task];
+    int touchedCount = 0;
+
+    for (int i = 0; i < form->length; i++) {
+        int slot = form->slots[i];
+        for (int k = job->itemStart[slot]; k < job->itemStart[slot + 1]; k++) {
+            int other = job->formsOfItem[k];
+            if (other == task) continue;
+            if (w->overlap[other]++ == 0) w->touched[touchedCount++] = other;
+        }
+    }
+    int formMax = 0;
+    for (int t = 0; t < touchedCount; t++) {
+        int other = w->touched[t];
+        int shared = w->overlap[other];
+        w->overlap[other] = 0;
+        if (shared > formMax) formMax = shared;
+        if (other > task && shared > job->maxOverlap) {
+            // The later form of the pair gets rebuilt
+            w->pairsOverLimit++;
+            atomic_store_explicit(&job->redo[other], 1, memory_order_relaxed);
+        }
+    }
+    job->forms[task].maxOverlap = formMax;
+    if (formMax > w->maxOverlap) w->maxOverlap = formMax;
+}
+
+// Indexes which forms use each item and measures all pairwise overlaps;
+// returns the number of form pairs over the limit and flags one form of
+// each such pair for rebuilding
+static long long measureFormOverlap(AssemblyJob* job, int threadCount, int* worstOverlap) {
+    int formCount = job->formCount;
+    memset(job->itemStart, 0, sizeof(int) * ((size_t)questionCount + 1));
+    for (int f = 0; f < formCount; f++) {
+        for (int i = 0; i < job->forms[f].length; i++) job->itemStart[job->forms[f].slots[i] + 1]++;
+    }
+    for (int s = 0; s < questionCount; s++) job->itemStart[s + 1] += job->itemStart[s];
+    for (int f = 0; f < formCount; f++) {
+        for (int i = 0; i < job->forms[f].length; i++) {
+            int slot = job->forms[f].slots[i];
+            job->formsOfItem[job->itemStart[slot]++] = f;
+        }
+    }
+    for (int s = questionCount; s > 0; s--) job->itemStart[s] = job->itemStart[s - 1];
+    job->itemStart[0] = 0;
+
+    for (int f = 0; f < formCount; f++) atomic_store_explicit(&job->redo[f], 0, memory_order_relaxed);
+    for (int w = 0; w < threadCount; w++) {
+        job->workers[w].pairsOverLimit = 0;
+        job->workers[w].maxOverlap = 0;
+    }
+    parallelFor(threadCount, formCount, measureOverlapTask, job);
+
+    long long pairsOverLimit = 0;
+    *worstOverlap = 0;
+    for (int w = 0; w < threadCount; w++) {
+        pairsOverLimit += job->workers[w].pairsOverLimit;
+        if (job->workers[w].maxOverlap > *worstOverlap) *worstOverlap = job->workers[w].maxOverlap;
+    }
+    return pairsOverLimit;
+}
+
+// Items per difficulty for a form of formLength items, split by percent[1..3]
+// with largest remainders so the counts add up exactly
+static void formBlueprint(const long percent[4], int formLength, int target[4]) {
+    long total = percent[1] + percent[2] + percent[3];
+    double remainder[4] = {0};
+    int assigned = 0;
+    for (int d = 1; d <= 3; d++) {
+        double exact = total > 0 ? (double)formLength * percent[d] / total : 0.0;
+        target[d] = (int)exact;
+        remainder[d] = exact - target[d];
+        assigned += target[d];
+    }
+    while (assigned < formLength && total > 0) {
+        int best = 1;
+        for (int d = 2; d <= 3; d++) {
+            if (remainder[d] > remainder[best]) best = d;
+        }
+        target[best]++;
+        remainder[best] = -1.0;
+        assigned++;
+    }
+}
+
+int runFormAssembly(int formCount, int formLength, const long* mixPercent, int maxOverlap,
+                    int threadCount, const char* outPath) {
+    AssemblyJob job;
+    long percent[4];
+    memset(&job, 0, sizeof(job));
+
+    refreshBankIndexes();
+    if (formCount <= 0 || formLength <= 0 || formLength > MAX_EXAM_QUESTIONS) {
+        printf("Forms need between 1 and %d items\n", MAX_EXAM_QUESTIONS);
+        return -1;
+    }
+    for (int d = 1; d <= 3; d++) {
+        percent[d] = mixPercent != NULL ? mixPercent[d]
+                                        : atomic_load_explicit(&aggregates.questionCount[d], memory_order_relaxed);
+    }
+    formBlueprint(percent, formLength, job.target);
+    for (int d = 1; d <= 3; d++) {
+        if (job.target[d] > difficultySlotCount[d]) {
+            printf("The blueprint needs %d %s item(s) per form but the bank has %d\n", job.target[d],
+                   d == 1 ? "easy" : d == 2 ? "medium" : "hard", difficultySlotCount[d]);
+            return -1;
+        }
+        // Lowest cap that lets every form fill its blueprint, plus one use of
+        // slack so rebuilt forms still have a choice of items
+        long long needed = (long long)formCount * job.target[d];
+        job.exposureCap[d] = difficultySlotCount[d] > 0
+            ? (int)((needed + difficultySlotCount[d] - 1) / difficultySlotCount[d]) + 1 : 0;
+    }
+    if (maxOverlap < 0) maxOverlap = formLength / 4;
+
+    job.formCount = formCount;
+    job.formLength = formLength;
+    job.maxOverlap = maxOverlap;
+    job.forms = (PaperForm*)calloc((size_t)formCount, sizeof(PaperForm));
+    job.exposure = (atomic_int*)calloc((size_t)questionCount, sizeof(atomic_int));
+    job.redo = (atomic_int*)calloc((size_t)formCount, sizeof(atomic_int));
+    job.itemStart = (int*)calloc((size_t)questionCount + 1, sizeof(int));
+    job.formsOfItem = (int*)malloc(sizeof(int) * (size_t)formCount * formLength);
+    if (threadCount <= 0) threadCount = hardwareThreads();
+    if (threadCount > formCount) threadCount = formCount;
+    job.workers = (AssemblyWorker*)calloc((size_t)threadCount, sizeof(AssemblyWorker));
+    PaperForm* bestForms = (PaperForm*)malloc(sizeof(PaperForm) * (size_t)formCount);
+    int ok = job.forms != NULL && job.exposure != NULL && job.redo != NULL && job.itemStart != NULL &&
+             job.formsOfItem != NULL && job.workers != NULL && bestForms != NULL;
+    for (int w = 0; ok && w < threadCount; w++) {
+        job.workers[w].overlap = (int*)calloc((size_t)formCount, sizeof(int));
+        job.workers[w].touched = (int*)malloc(sizeof(int) * (size_t)formCount);
+        ok = job.workers[w].overlap != NULL && job.workers[w].touched != NULL;
+    }
+
+    uint64_t start = monotonicNs();
+    int rebuilt = 0;
+    long long pairsOverLimit = 0, bestPairs = -1;
+    int worstOverlap = 0;
+    for (job.round = 0; ok && job.round <= FORM_REPAIR_ROUNDS; job.round++) {
+        parallelFor(threadCount, formCount, assembleFormTask, &job);
+        pairsOverLimit = measureFormOverlap(&job, threadCount, &worstOverlap);
+        if (bestPairs < 0 || pairsOverLimit < bestPairs) {
+            bestPairs = pairsOverLimit;
+            memcpy(bestForms, job.forms, sizeof(PaperForm) * (size_t)formCount);
+        }
+        if (pairsOverLimit == 0 || job.round == FORM_REPAIR_ROUNDS) break;
+
+        // Release the items of the forms to rebuild
+        for (int f = 0; f < formCount; f++) {
+            if (!atomic_load_explicit(&job.redo[f], memory_order_relaxed)) continue;
+            for (int i = 0; i < job.forms[f].length; i++) {
+                atomic_fetch_sub_explicit(&job.exposure[job.forms[f].slots[i]], 1, memory_order_relaxed);
+            }
+            rebuilt++;
+        }
+    }
+    // When the limit cannot be met, rebuilding crowds forms onto the few
+    // items left under their caps; keep the round that came closest
+    if (ok && pairsOverLimit > bestPairs) {
+        memcpy(job.forms, bestForms, sizeof(PaperForm) * (size_t)formCount);
+        pairsOverLimit = measureFormOverlap(&job, threadCount, &worstOverlap);
+    }
+    uint64_t elapsed = monotonicNs() - start;
+
+    if (!ok) {
+        printf("Out of memory assembling forms!\n");
+    } else {
+        int blueprintMet = 0, withinLimit = 0, maxExposure = 0, itemsUsed = 0;
+        long long sharedPairs = 0;
+        for (int f = 0; f < formCount; f++) {
+            const PaperForm* form = &job.forms[f];
+            if (form->counts[1] == job.target[1] && form->counts[2] == job.target[2] &&
+                form->counts[3] == job.target[3]) {
+                blueprintMet++;
+            }
+            if (form->maxOverlap <= maxOverlap) withinLimit++;
+        }
+        for (int s = 0; s < questionCount; s++) {
+            long long users = job.itemStart[s + 1] - job.itemStart[s];
+            if (users > 0) itemsUsed++;
+            if (users > maxExposure) maxExposure = (int)users;
+            sharedPairs += users * (users - 1) / 2;
+        }
+        double pairs = (double)formCount * (formCount - 1) / 2;
+        double seconds = elapsed / 1e9;
+
+        printf("\n===========================================\n");
+        printf("       FORM ASSEMBLY\n");
+        printf("===========================================\n");
+        printf("Assembled %d form(s) of %d item(s) in %.3f s on %d thread(s) (%.0f forms/sec)\n",
+               formCount, formLength, seconds, threadCount, seconds > 0 ? formCount / seconds : 0.0);
+        printf("Blueprint per form: %d easy, %d medium, %d hard\n", job.target[1], job.target[2], job.target[3]);
+        printf("Forms matching the blueprint: %d of %d (%.1f%%)\n", blueprintMet, formCount,
+               blueprintMet * 100.0 / formCount);
+        printf("Item exposure: %d of %d question(s) used, at most %d form(s) per item (caps %d/%d/%d)\n",
+               itemsUsed, questionCount, maxExposure, job.exposureCap[1], job.exposureCap[2], job.exposureCap[3]);
+        printf("Overlap between forms: mean %.2f, max %d item(s), limit %d\n",
+               pairs > 0 ? sharedPairs / pairs : 0.0, worstOverlap, maxOverlap);
+        printf("Forms within the overlap limit: %d of %d (%lld pair(s) over, %d form(s) rebuilt)\n",
+               withinLimit, formCount, pairsOverLimit, rebuilt);
+        printf("===========================================\n");
+
+        if (outPath != NULL) {
+            FILE* out = fopen(outPath, "w");
+            if (out == NULL) {
+                printf("Cannot write %s\n", outPath);
+                ok = 0;
+            } else {
+                fprintf(out, "# %d form(s), blueprint %d easy / %d medium / %d hard, overlap limit %d\n",
+                        formCount, job.target[1], job.target[2], job.target[3], maxOverlap);
+                for (int f = 0; f < formCount; f++) {
+                    const PaperForm* form = &job.forms[f];
+                    fprintf(out, "# form %d: easy %d/%d medium %d/%d hard %d/%d, max overlap %d\n", f + 1,
+                            form->counts[1], job.target[1], form->counts[2], job.target[2],
+                            form->counts[3], job.target[3], form->maxOverlap);
+                    fprintf(out, "FORM %d", f + 1);
+                    for (int i = 0; i < form->length; i++) fprintf(out, " %lld", questions[form->slots[i]].id);
+                    fputc('\n', out);
+                }
+                if (fclose(out) != 0) ok = 0;
+                else printf("Wrote the forms to %s\n", outPath);
+            }
+        }
+    }
+
+    for (int w = 0; job.workers != NULL && w < threadCount; w++) {
+        free(job.workers[w].overlap);
+        free(job.workers[w].touched);
+    }
+    free(job.workers);
+    free(job.forms);
+    free(bestForms);
+    free((void*)job.exposure);
+    free((void*)job.redo);
+    free(job.itemStart);
+    free(job.formsOfItem);
+    return ok ? 0 : -1;
+}
+
+// Decision Path Table
+// In tree mode the next question depends only on the outcomes so far
+// (correct, wrong, skipped), so the picks for every prefix up to
+// PATH_TABLE_DEPTH answers are worked out once per bank version. The
+// prefixes form a complete ternary tree stored as an array: the children of
+// entry k are 3k+1 (correct), 3k+2 (wrong) and 3k+3 (skipped), matching the
+// AnswerResult values. A session then serves its first questions with one
+// lookup each instead of walking the tree and the availability index.
+
+// Replays the outcomes leading to one entry and returns the slot picked there
+static int resolvePathEntry(int entry, AskedSet* asked) {
+    AnswerResult outcomes[PATH_TABLE_DEPTH];
+    int depth = 0;
+    for (int k = entry; k > 0; k = (k - 1) / 3) outcomes[depth++] = (AnswerResult)((k - 1) % 3);
+
+    clearAskedSet(asked);
+    int node = pathStartNode;
+    while (depth > 0) {
+        Question* q = pickTreeQuestion(node, asked);
+        if (q == NULL) return -1;
+        node = nextTreeNode(node, outcomes[--depth], asked);
+        if (markAsked(asked, q - questions) != 0) return -1;
+    }
+    Question* q = pickTreeQuestion(node, asked);
+    return q != NULL ? (int)(q - questions) : -1;
+}
+
+void buildPathTable(void) {
+    AskedSet asked;
+    freePathTable();
+    refreshBankIndexes();
+
+    // Start at a medium question, or at the root if there is none
+    pathStartNode = findStartNode(&adaptiveTree, 2);
+    if (pathStartNode < 0) pathStartNode = 0;
+    pathTableVersion = bankVersion;
+    if (adaptiveTree.size == 0 || initAskedSet(&asked, questionCount) != 0) return;
+
+    pathTable = (int*)malloc(sizeof(int) * PATH_TABLE_SIZE);
+    if (pathTable != NULL) {
+        for (int k = 0; k < PATH_TABLE_SIZE; k++) {
+            // The bank ran out further up this path
+            int parent = (k - 1) / 3;
+            pathTable[k] = k > 0 && pathTable[parent] < 0 ? -1 : resolvePathEntry(k, &asked);
+        }
+    }
+    freeAskedSet(&asked);
+}
+
+void freePathTable(void) {
+    free(pathTable);
+    pathTable = NULL;
+    pathStartNode = -1;
+    pathTableVersion = 0;
+}
+
+// Exam Engine
+// A session is driven by repeated sessionNextQuestion()/submitAnswer() calls
+// and closed with finishSession(). Front-ends (console, network) only do I/O.
+void initSession(ExamSession* s) {
+    memset(s, 0, sizeof(*s));
+    s->currentNode = -1;
+}
+
+// Returns -1 when the bank is empty or the asked set cannot be allocated
+int startSession(ExamSession* s, int numQuestions, ExamMode mode) {
+    refreshBankIndexes();
+    if (adaptiveTree.size == 0) return -1;
+
+    if (s->asked.bits == NULL || s->asked.wordCount != (questionCount + 63) / 64) {
+        freeAskedSet(&s->asked);
+        if (initAskedSet(&s->asked, questionCount) != 0) return -1;
+    } else {
+        clearAskedSet(&s->asked);
+    }
+
+    resetStats(s);
+    s->numQuestions = numQuestions > MAX_EXAM_QUESTIONS ? MAX_EXAM_QUESTIONS : numQuestions;
+    s->askedCount = 0;
+    s->pending = NULL;
+    s->bankVersion = bankVersion;
+    s->mode = mode;
+    s->timeouts = 0;
+    s->questionDeadlineNs = 0;
+    s->examDeadlineNs = examTimeLimitNs > 0 ? monotonicNs() + examTimeLimitNs : 0;
+
+    if (mode == EXAM_MODE_IRT) {
+        initAbilityEstimate(s);
+        s->currentNode = -1;
+        return 0;
+    }
+
+    if (pathTableVersion != bankVersion) buildPathTable();
+    s->currentNode = pathStartNode;
+    s->pathNode = pathTable != NULL ? 0 : -1;
+    return 0;
+}
+
+// Returns the question to show next (the same one until it is answered),
+// or NULL once the exam is over or its time is up
+Question* sessionNextQuestion(ExamSession* s) {
+    if (s->pending != NULL) return s->pending;
+    if (s->askedCount >= s->numQuestions || s->bankVersion != bankVersion) return NULL;
+    if (s->examDeadlineNs != 0 && monotonicNs() >= s->examDeadlineNs) return NULL;
+
+    Question* q = NULL;
+    if (s->mode == EXAM_MODE_IRT) {
+        q = selectIrtQuestion(s);
+        if (q == NULL) q = getAnyUnaskedQuestion(&s->asked);
+    } else if (s->pathNode >= 0) {
+        // Precomputed for this outcome prefix
+        int slot = pathTable[s->pathNode];
+        q = slot >= 0 ? &questions[slot] : NULL;
+    } else {
+        q = pickTreeQuestion(s->currentNode, &s->asked);
+    }
+
+    s->pending = q;
+    s->shownAtNs = monotonicNs();
+    // The question's own limit, cut short by the end of the exam
+    s->questionDeadlineNs = s->examDeadlineNs;
+    if (questionTimeLimitNs > 0 &&
+        (s->questionDeadlineNs == 0 || s->shownAtNs + questionTimeLimitNs < s->questionDeadlineNs)) {
+        s->questionDeadlineNs = s->shownAtNs + questionTimeLimitNs;
+    }
+    return q;
+}
+
+// Answers the pending question. 'S' (or 0 for unreadable input) skips it,
+// and so does any answer given after the question's deadline.
+AnswerResult submitAnswer(ExamSession* s, char answer) {
+    Question* q = s->pending;
+    AnswerResult result;
+    if (q == NULL) return ANSWER_NO_QUESTION;
+    uint64_t now = monotonicNs();
+    uint64_t elapsedNs = now - s->shownAtNs;
+    int late = s->questionDeadlineNs != 0 && now >= s->questionDeadlineNs;
+    if (late) {
+        answer = 0;
+        s->timeouts++;
+    }
+
+    if (answer == 0 || toupper((unsigned char)answer) == 'S') {
+        s->stats.skippedQuestions++;
+        updateStats(&s->stats, 0, q->difficulty, elapsedNs);
+        result = ANSWER_SKIPPED;
+    } else if (trackAnswer(s, q, answer, elapsedNs)) {
+        if (s->mode == EXAM_MODE_IRT) updateAbilityEstimate(s, q, 1);
+        result = ANSWER_CORRECT;
+    } else {
+        if (s->mode == EXAM_MODE_IRT) updateAbilityEstimate(s, q, 0);
+        result = ANSWER_WRONG;
+    }
+    if (s->mode == EXAM_MODE_TREE) {
+        // The tree position is kept up to date even on the table, so the
+        // exam carries on live once it runs past PATH_TABLE_DEPTH
+        s->currentNode = nextTreeNode(s->currentNode, result, &s->asked);
+        if (s->pathNode >= 0) {
+            s->pathNode = 3 * s->pathNode + 1 + result;
+            if (s->pathNode >= PATH_TABLE_SIZE) s->pathNode = -1;
+        }
+    }
+
+    recordResponse(s, q, result == ANSWER_SKIPPED ? 0 : answer, result == ANSWER_CORRECT, elapsedNs);
+    // Out of memory here only means the question may come up again
+    (void)markAsked(&s->asked, q - questions);
+    s->askedCount++;
+    s->pending = NULL;
+    s->questionDeadlineNs = 0;
+    return late ? ANSWER_TIMED_OUT : result;
+}
+
+// Skips the pending question if its deadline has passed by nowNs; returns 1
+// when it did. Front-ends call this when a deadline timer fires, and the
+// next sessionNextQuestion() ends the exam once the exam time is up.
+int expireSession(ExamSession* s, uint64_t nowNs) {
+    if (s->pending == NULL || s->questionDeadlineNs == 0 || nowNs < s->questionDeadlineNs) return 0;
+    submitAnswer(s, 0);
+    return 1;
+}
+
+// Stores the finished exam in the history and its responses in the response log
+void finishSession(ExamSession* s) {
+    recordExamResult(&s->stats);
+    for (int i = 0; i < s->responseCount; i++) {
+        s->responses[i].examCorrect = (uint16_t)s->stats.correctAnswers;
+        s->responses[i].examLength = (uint16_t)s->responseCount;
+    }
+    appendResponses(s->responses, s->responseCount);
+    s->responseCount = 0;
+    s->pending = NULL;
+    s->numQuestions = 0;
+}
+
+// Ends an exam the candidate walked away from: the question on screen is
+// skipped and the answers so far are recorded like a finished exam
+void abandonSession(ExamSession* s) {
+    if (s->pending != NULL) submitAnswer(s, 0);
+    finishSession(s);
+}
+
+void freeSession(ExamSession* s) {
+    freeAskedSet(&s->asked);
+    initSession(s);
+}
+
+// Reads the console answer to the pending question, giving up at deadlineNs
+// (0 waits for as long as it takes). Returns 1 with *answer set, 0 for
+// unreadable input and -1 when the time ran out or stdin cannot be polled.
+// stdin is unbuffered while deadlines are in force (see main), so poll()
+// sees every unread byte.
+static int readConsoleAnswer(uint64_t deadlineNs, char* answer) {
+#ifndef _WIN32
+    if (deadlineNs != 0) {
+        char line[64];
+        for (;;) {
+            uint64_t now = monotonicNs();
+            if (now >= deadlineNs) return -1;
+            struct pollfd input = {STDIN_FILENO, POLLIN, 0};
+            int ready = poll(&input, 1, (int)((deadlineNs - now + 999999) / 1000000));
+            if (ready < 0) {
+                if (errno == EINTR) continue;  // a signal, not input: keep waiting
+                return -1;
+            }
+            if (ready == 0) continue;
+            if (fgets(line, sizeof(line), stdin) == NULL) return 0;
+            if (strchr(line, '\n') == NULL) flushInput();
+            for (const char* p = line; *p != '\0'; p++) {
+                if (!isspace((unsigned char)*p)) {
+                    *answer = *p;
+                    return 1;
+                }
+            }
+        }
+    }
+#endif
+    // Without poll() a late answer is still caught by submitAnswer()
+    if (scanf(" %c", answer) != 1) return 0;
+    flushInput();
+    return 1;
+}
+
+// Main adaptive exam functionality: console front-end for the exam engine
+void takeAdaptiveExam() {
+    int examChoice;
+    printf("\n===========================================\n");
+    printf("     ADAPTIVE EXAMINATION MODE\n");
+    printf("===========================================\n");
+    printf("1. 5 Questions Exam\n");
+    printf("2. 10 Questions Exam\n");
+    printf("3. 5 Questions Exam (IRT ability estimate)\n");
+    printf("4. 10 Questions Exam (IRT ability estimate)\n");
+    printf("Enter your choice: ");
+
+    if (scanf("%d", &examChoice) != 1) {
+        printf("Invalid input. Returning to menu.\n");
+        flushInput();
+        return;
+    }
+    flushInput();
+    if (examChoice < 1 || examChoice > 4) {
+        printf("Invalid choice. Returning to menu.\n");
+        return;
+    }
+
+    int numQuestions = (examChoice == 1 || examChoice == 3) ? 5 : 10;
+    ExamMode mode = (examChoice == 3 || examChoice == 4) ? EXAM_MODE_IRT : EXAM_MODE_TREE;
+
+    if (startSession(&consoleSession, numQuestions, mode) != 0) {
+        printf("\nNo questions in bank.\n");
+        return;
+    }
+
+    printf("\nExam starting! Good luck!\n\n");
+
+    Question* q;
+    while ((q = sessionNextQuestion(&consoleSession)) != NULL) {
+        displayQuestion(q);
+        uint64_t deadlineNs = consoleSession.questionDeadlineNs;
+        uint64_t now = monotonicNs();
+        if (deadlineNs > now) {
+            char left[32];
+            formatDuration(deadlineNs - now, left, sizeof(left));
+            printf("Time left for this question: %s\n", left);
+        }
+        printf("Enter your answer (A/B/C/D) or S to skip: ");
+        fflush(stdout);
+        char answer = 0;
+        int status = readConsoleAnswer(deadlineNs, &answer);
+        if (status == 0) {
+            printf("Invalid input. Skipping question.\n");
+            flushInput();
+            submitAnswer(&consoleSession, 0);
+            continue;
+        }
+
+        AnswerResult result = submitAnswer(&consoleSession, status > 0 ? answer : 0);
+        if (result == ANSWER_TIMED_OUT) {
+            printf("\nTime is up! Question skipped.\n");
+            continue;
+        }
+        if (result == ANSWER_SKIPPED) {
+            printf("Question skipped!\n");
+            continue;
+        }
+        if (result == ANSWER_CORRECT) {
+            printf("\nCorrect! Well done!\n");
+        } else {
+            printf("\nWrong! Correct answer was %c\n", q->correctAnswer);
+        }
+
+        printf("\nPress Enter to continue...");
+        getchar();
+    }
+
+    // Display results
+    evaluateResults(&consoleSession);
+    displayResults(&consoleSession);
+
+    printf("\nPress Enter to return to main menu...");
+    getchar();
+}
+
+// Extra Functionality 1: View Question Bank
+// The blocks are pre-rendered, so the dump is mostly memcpy into 64 KB writes
+void viewQuestionBank() {
+    static OutputBuffer out;
+    char line[128];
+    int i;
+    flushAnswerEvents();
+    printf("\n\n===========================================\n");
+    printf("          QUESTION BANK\n");
+    printf("===========================================\n");
+    printf("Total Questions: %d\n\n", questionCount);
 
     for (i = 0; i < questionCount; i++) {
-        printf("Question %d:\n", i + 1);
-        displayQuestion(&questions[i]);
-        printf("Attempts: %d | Correct: %d | Success Rate: %.1f%%\n\n",
-               questions[i].attempts,
-               questions[i].correctCount,
-               questions[i].attempts > 0 ?
-               (float)questions[i].correctCount / questions[i].attempts * 100.0f : 0.0f);
+        size_t blockLength;
+        const char* block = renderedQuestion(i, RENDER_CONSOLE, &blockLength);
+        int length = snprintf(line, sizeof(line), "Question %d:\n", i + 1);
+        outputAppend(&out, line, (size_t)length);
+        outputAppend(&out, block, blockLength);
+        int attempts = atomic_load_explicit(&questionAttempts[i], memory_order_relaxed);
+        int correct = atomic_load_explicit(&questionCorrect[i], memory_order_relaxed);
+        length = snprintf(line, sizeof(line), "Attempts: %d | Correct: %d | Success Rate: %.1f%%\n\n",
+                          attempts, correct, attempts > 0 ? (float)correct / attempts * 100.0f : 0.0f);
+        outputAppend(&out, line, (size_t)length);
     }
+    outputFlush(&out);
 
     printf("Press Enter to continue...");
     getchar();
@@ -633,68 +6086,65 @@ void viewQuestionBank() {
 
 // Extra Functionality 2: Performance Analysis
 void viewPerformanceAnalysis() {
-    int i;
-    int easyCorrect = 0, easyAttempted = 0;
-    int mediumCorrect = 0, mediumAttempted = 0;
-    int hardCorrect = 0, hardAttempted = 0;
+    static const char* difficultyNames[4] = {"", "Easy", "Medium", "Hard"};
+    flushAnswerEvents();
+    long long examCount = atomic_load_explicit(&aggregates.examCount, memory_order_relaxed);
 
-    if (totalExamsTaken == 0 && performanceCount == 0) {
+    if (examCount == 0 && consoleSession.performanceCount == 0) {
         printf("\nNo exam history available yet!\n");
         printf("Press Enter to continue...");
         getchar();
         return;
     }
 
-    // Calculate overall performance by difficulty
-    for (i = 0; i < questionCount; i++) {
-        if (questions[i].difficulty == 1) {
-            easyAttempted += questions[i].attempts;
-            easyCorrect += questions[i].correctCount;
-        } else if (questions[i].difficulty == 2) {
-            mediumAttempted += questions[i].attempts;
-            mediumCorrect += questions[i].correctCount;
-        } else if (questions[i].difficulty == 3) {
-            hardAttempted += questions[i].attempts;
-            hardCorrect += questions[i].correctCount;
-        }
-    }
-
     printf("\n\n===========================================\n");
     printf("       PERFORMANCE ANALYSIS\n");
     printf("===========================================\n");
 
-    if (easyAttempted > 0) {
-        printf("Easy Questions:\n");
-        printf("  Attempted: %d | Correct: %d | Success Rate: %.1f%%\n",
-               easyAttempted, easyCorrect, (float)easyCorrect / easyAttempted * 100.0f);
+    // Overall performance by difficulty, from the running totals
+    int printed = 0;
+    for (int d = 1; d <= 3; d++) {
+        long attempted = atomic_load_explicit(&aggregates.attempts[d], memory_order_relaxed);
+        long correct = atomic_load_explicit(&aggregates.correct[d], memory_order_relaxed);
+        if (attempted == 0) continue;
+        printf("%s%s Questions:\n", printed++ ? "\n" : "", difficultyNames[d]);
+        printf("  Attempted: %ld | Correct: %ld | Success Rate: %.1f%%\n",
+               attempted, correct, (float)correct / attempted * 100.0f);
+        displayLatencyHistogram(&difficultyLatency[d]);
     }
 
-    if (mediumAttempted > 0) {
-        printf("\nMedium Questions:\n");
-        printf("  Attempted: %d | Correct: %d | Success Rate: %.1f%%\n",
-               mediumAttempted, mediumCorrect, (float)mediumCorrect / mediumAttempted * 100.0f);
-    }
+    printf("\n===========================================\n");
 
-    if (hardAttempted > 0) {
-        printf("\nHard Questions:\n");
-        printf("  Attempted: %d | Correct: %d | Success Rate: %.1f%%\n",
-               hardAttempted, hardCorrect, (float)hardCorrect / hardAttempted * 100.0f);
+    // Questions with the slowest median answer time (mean breaks ties)
+    int slowSlots[SLOWEST_QUESTIONS_SHOWN];
+    uint64_t slowMedian[SLOWEST_QUESTIONS_SHOWN];
+    uint64_t slowMean[SLOWEST_QUESTIONS_SHOWN];
+    rankSlowQuestions();
+    acquireFlag(&slowQuestions.lock);
+    int slowCount = slowQuestions.count;
+    memcpy(slowSlots, slowQuestions.slots, sizeof(slowSlots));
+    memcpy(slowMedian, slowQuestions.medianNs, sizeof(slowMedian));
+    memcpy(slowMean, slowQuestions.meanNs, sizeof(slowMean));
+    releaseFlag(&slowQuestions.lock);
+    if (slowCount > 0) {
+        printf("\nSlowest Questions (median answer time):\n");
+        for (int k = 0; k < slowCount; k++) {
+            const Question* q = &questions[slowSlots[k]];
+            char median[16], mean[16];
+            formatDuration(slowMedian[k], median, sizeof(median));
+            formatDuration(slowMean[k], mean, sizeof(mean));
+            printf("  Q%lld: median %s, mean %s over %u answer(s)\n",
+                   q->id, median, mean, questionLatency[slowSlots[k]]->count);
+        }
+        printf("\n===========================================\n");
     }
 
-    printf("\n===========================================\n");
-
     // Overall performance across all exams
     printf("\nOverall Exam Performance:\n");
-    printf("Total Exams Taken: %d\n", totalExamsTaken);
-
-    if (totalExamsTaken > 0) {
-        float totalScore = 0;
-        for (i = 0; i < totalExamsTaken; i++) {
-            if (allExams[i].totalQuestions > 0) {
-                totalScore += (float)allExams[i].correctAnswers / allExams[i].totalQuestions * 100.0f;
-            }
-        }
-        printf("Average Score Across All Exams: %.2f%%\n", totalScore / totalExamsTaken);
+    printf("Total Exams Taken: %lld\n", examCount);
+    if (examCount > 0) {
+        long long scoreSum = atomic_load_explicit(&aggregates.scoreSumMilli, memory_order_relaxed);
+        printf("Average Score Across All Exams: %.2f%%\n", scoreSum / 1000.0 / examCount);
     } else {
         printf("Average Score Across All Exams: N/A\n");
     }
@@ -707,25 +6157,22 @@ void viewPerformanceAnalysis() {
 // Extra Functionality 3: Difficulty Statistics
 void viewDifficultyStatistics() {
     int i;
-    int easyCount = 0, mediumCount = 0, hardCount = 0;
+    flushAnswerEvents();
+    long easyCount = atomic_load_explicit(&aggregates.questionCount[1], memory_order_relaxed);
+    long mediumCount = atomic_load_explicit(&aggregates.questionCount[2], memory_order_relaxed);
+    long hardCount = atomic_load_explicit(&aggregates.questionCount[3], memory_order_relaxed);
 
     printf("\n\n===========================================\n");
     printf("       DIFFICULTY STATISTICS\n");
     printf("===========================================\n");
 
-    for (i = 0; i < questionCount; i++) {
-        if (questions[i].difficulty == 1) easyCount++;
-        else if (questions[i].difficulty == 2) mediumCount++;
-        else if (questions[i].difficulty == 3) hardCount++;
-    }
-
     if (questionCount == 0) {
         printf("No questions in bank.\n");
     } else {
         printf("Question Bank Distribution:\n");
-        printf("Easy Questions: %d (%.1f%%)\n", easyCount, (float)easyCount / questionCount * 100.0f);
-        printf("Medium Questions: %d (%.1f%%)\n", mediumCount, (float)mediumCount / questionCount * 100.0f);
-        printf("Hard Questions: %d (%.1f%%)\n", hardCount, (float)hardCount / questionCount * 100.0f);
+        printf("Easy Questions: %ld (%.1f%%)\n", easyCount, (float)easyCount / questionCount * 100.0f);
+        printf("Medium Questions: %ld (%.1f%%)\n", mediumCount, (float)mediumCount / questionCount * 100.0f);
+        printf("Hard Questions: %ld (%.1f%%)\n", hardCount, (float)hardCount / questionCount * 100.0f);
     }
 
     printf("\n===========================================\n");
@@ -733,15 +6180,16 @@ void viewDifficultyStatistics() {
 
     for (i = 0; i < questionCount; i++) {
         char diffStr[10];
-        if (questions[i].difficulty == 1) strcpy(diffStr, "Easy");
-        else if (questions[i].difficulty == 2) strcpy(diffStr, "Medium");
+        int attempts = atomic_load_explicit(&questionAttempts[i], memory_order_relaxed);
+        int correct = atomic_load_explicit(&questionCorrect[i], memory_order_relaxed);
+        if (questionDifficulty[i] == 1) strcpy(diffStr, "Easy");
+        else if (questionDifficulty[i] == 2) strcpy(diffStr, "Medium");
         else strcpy(diffStr, "Hard");
 
-        printf("Q%d (%s): ", questions[i].id, diffStr);
-        if (questions[i].attempts > 0) {
+        printf("Q%lld (%s): ", questions[i].id, diffStr);
+        if (attempts > 0) {
             printf("Success Rate: %.1f%% (%d/%d)\n",
-                   (float)questions[i].correctCount / questions[i].attempts * 100.0f,
-                   questions[i].correctCount, questions[i].attempts);
+                   (float)correct / attempts * 100.0f, correct, attempts);
         } else {
             printf("Not yet attempted\n");
         }
@@ -755,30 +6203,463 @@ void viewDifficultyStatistics() {
 
 // Extra Functionality 4: Exam History
 void displayExamHistory() {
-    int i;
+    char* mapping;
+    size_t mappedSize;
+    long long recordCount;
 
     printf("\n\n===========================================\n");
     printf("          EXAM HISTORY\n");
     printf("===========================================\n");
 
-    if (totalExamsTaken == 0) {
+    const ExamRecord* records = mapHistoryRecords(&mapping, &mappedSize, &recordCount);
+    if (recordCount == 0) {
         printf("No exams taken yet!\n");
     } else {
-        for (i = 0; i < totalExamsTaken; i++) {
-            printf("\nExam %d:\n", i + 1);
-            printf("  Total Questions: %d\n", allExams[i].totalQuestions);
-            printf("  Correct Answers: %d\n", allExams[i].correctAnswers);
-            if (allExams[i].totalQuestions > 0) {
-                printf("  Score: %.1f%%\n",
-                       (float)allExams[i].correctAnswers / allExams[i].totalQuestions * 100.0f);
+        printf("Total Exams: %lld\n", recordCount);
+        for (long long i = 0; i < recordCount; i++) {
+            const ExamRecord* exam = &records[i];
+            char finished[32];
+            time_t finishedAt = (time_t)exam->finishedAt;
+            strftime(finished, sizeof(finished), "%Y-%m-%d %H:%M:%S", localtime(&finishedAt));
+
+            printf("\nExam %lld:\n", i + 1);
+            printf("  Finished: %s\n", finished);
+            printf("  Total Questions: %d\n", exam->totalQuestions);
+            printf("  Correct Answers: %d\n", exam->correctAnswers);
+            if (exam->totalQuestions > 0) {
+                printf("  Score: %.1f%%\n", recordScore(exam));
             } else {
                 printf("  Score: N/A\n");
             }
-            printf("  Average Difficulty: %.2f\n", allExams[i].averageDifficulty);
+            printf("  Average Difficulty: %.2f\n", exam->averageDifficulty);
+            printf("  Time Taken: %.1f s\n", exam->timeTakenNs / 1e9);
             printf("---------------------------------------\n");
+
+            if ((i + 1) % HISTORY_PAGE_SIZE == 0 && i + 1 < recordCount) {
+                printf("\nShowing %lld of %lld. Press Enter for more, Q to stop: ", i + 1, recordCount);
+                int c = getchar();
+                if (c != '\n') flushInput();
+                if (c == 'q' || c == 'Q' || c == EOF) break;
+            }
+        }
+    }
+    unmapFile(mapping, mappedSize);
+
+    printf("\nPress Enter to continue...");
+    getchar();
+}
+
+// Extra Functionality 5: Keyword Search
+void searchQuestionBank() {
+    char query[256];
+    int slots[SEARCH_RESULTS_SHOWN];
+
+    printf("\n\n===========================================\n");
+    printf("          SEARCH QUESTIONS\n");
+    printf("===========================================\n");
+    printf("Enter keywords (all must match): ");
+    if (fgets(query, sizeof(query), stdin) == NULL) return;
+    if (strchr(query, '\n') == NULL) flushInput();
+
+    uint64_t start = monotonicNs();
+    int matches = searchQuestions(query, slots, SEARCH_RESULTS_SHOWN);
+    double ms = (monotonicNs() - start) / 1e6;
+    if (matches == -2) {
+        printf("Search is unavailable without the index.\n");
+    } else if (matches < 0) {
+        printf("No keywords given.\n");
+    } else {
+        printf("Found %d question(s) in %.3f ms\n\n", matches, ms);
+        int shown = matches < SEARCH_RESULTS_SHOWN ? matches : SEARCH_RESULTS_SHOWN;
+        for (int i = 0; i < shown; i++) {
+            const Question* q = &questions[slots[i]];
+            printf("Q%lld (%s): %.*s\n", q->id,
+                   q->difficulty == 1 ? "Easy" : q->difficulty == 2 ? "Medium" : "Hard",
+                   (int)q->question.length, textOf(q->question));
         }
+        if (matches > shown) printf("... and %d more\n", matches - shown);
     }
+    printf("===========================================\n");
 
     printf("\nPress Enter to continue...");
     getchar();
 }
+
+// Exam Server
+// Serves adaptive exams over TCP from a single non-blocking epoll loop.
+// The protocol is line based (each line ends in '\n'):
+//   client: START [n]             begin an exam of n questions (default 10)
+//   client: ANSWER <A|B|C|D|S>    answer (or skip) the current question
+//   client: SEARCH words          find questions containing every word
+//   client: QUIT                  close the connection
+//   server: QUESTION <TAB> id <TAB> difficulty <TAB> question <TAB> A <TAB> B <TAB> C <TAB> D
+//   server: CORRECT | WRONG <answer> | SKIPPED
+//   server: TIMEOUT               the question's time ran out and it was skipped
+//   server: RESULT total correct wrong skipped score% averageDifficulty
+//   server: MATCHES count id...   (the first SEARCH_RESULTS_SHOWN ids, bank order)
+//   server: ERROR <message>
+// Every answer is followed by the next QUESTION or, at the end, the RESULT.
+// Deadlines (--time-limit, --question-time) and idle connections
+// (--idle-timeout) are tracked on one timer wheel that sets the epoll wait;
+// an expired question is answered with TIMEOUT and the exam carries on.
+#ifdef __linux__
+#define SERVER_MAX_EVENTS 256
+#define SERVER_LINE_MAX 256
+#define SERVER_OUTPUT_MAX (1 << 20)  // unsent reply bytes before a client that is not reading is dropped
+
+typedef struct ServerConnection {
+    struct ServerConnection* next;   // open connections, freed when the server stops
+    struct ServerConnection* prev;
+    int fd;
+    int inExam;
+    ExamSession session;
+    char in[SERVER_LINE_MAX];
+    int inLength;
+    char* out;
+    size_t outLength;
+    size_t outSent;
+    size_t outCapacity;
+    int wantWrite;   // EPOLLOUT is armed
+    int overflow;    // a reply hit SERVER_OUTPUT_MAX or could not be buffered; close
+    TimerEntry deadline;   // armed at the pending question's deadline
+    TimerEntry idle;       // armed at the last request plus idleTimeoutNs
+} ServerConnection;
+
+static volatile sig_atomic_t serverRunning = 1;
+static TimerWheel serverTimers;
+static ServerConnection* serverConnections = NULL;
+static int serverEpollFd = -1;
+
+static void stopServer(int sig) {
+    (void)sig;
+    serverRunning = 0;
+}
+
+// Buffers a reply; sets overflow instead when the client has too much
+// unread output or the buffer cannot grow
+static void connAppend(ServerConnection* c, const char* data, size_t length) {
+    if (c->overflow) return;
+    if (c->outLength + length > SERVER_OUTPUT_MAX) {
+        c->overflow = 1;
+        return;
+    }
+    if (c->outLength + length > c->outCapacity) {
+        size_t capacity = c->outCapacity ? c->outCapacity : 512;
+        while (capacity < c->outLength + length) capacity *= 2;
+        char* out = (char*)realloc(c->out, capacity);
+        if (out == NULL) {
+            c->overflow = 1;
+            return;
+        }
+        c->out = out;
+        c->outCapacity = capacity;
+    }
+    memcpy(c->out + c->outLength, data, length);
+    c->outLength += length;
+}
+
+static void connAppendf(ServerConnection* c, const char* format, ...) {
+    char line[SERVER_LINE_MAX];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    if (length > 0) connAppend(c, line, (size_t)length < sizeof(line) ? (size_t)length : sizeof(line) - 1);
+}
+
+// Sends the next question, or the result once the exam is over
+static void serveNextQuestion(ServerConnection* c) {
+    Question* q = sessionNextQuestion(&c->session);
+    if (q != NULL) {
+        size_t length;
+        const char* line = renderedQuestion((int)(q - questions), RENDER_PROTOCOL, &length);
+        connAppend(c, line, length);
+        return;
+    }
+
+    const ExamStats* stats = &c->session.stats;
+    connAppendf(c, "RESULT %d %d %d %d %.2f %.2f",
+                stats->totalQuestions, stats->correctAnswers, stats->wrongAnswers,
+                stats->skippedQuestions,
+                stats->totalQuestions > 0 ? (float)stats->correctAnswers / stats->totalQuestions * 100.0f : 0.0f,
+                stats->averageDifficulty);
+    if (c->session.mode == EXAM_MODE_IRT) {
+        connAppendf(c, " %.3f %.3f", c->session.theta, c->session.thetaSE);
+    }
+    connAppend(c, "\n", 1);
+    finishSession(&c->session);
+    c->inExam = 0;
+}
+
+// Handles one request line; returns 0 when the connection should close
+static int handleServerLine(ServerConnection* c, char* line) {
+    if (strncmp(line, "START", 5) == 0) {
+        int numQuestions = 10;
+        ExamMode mode = EXAM_MODE_TREE;
+        char* save = NULL;
+        for (char* arg = strtok_r(line + 5, " ", &save); arg != NULL; arg = strtok_r(NULL, " ", &save)) {
+            if (strcmp(arg, "IRT") == 0) mode = EXAM_MODE_IRT;
+            else numQuestions = atoi(arg);
+        }
+        if (numQuestions <= 0) numQuestions = 10;
+        if (startSession(&c->session, numQuestions, mode) != 0) {
+            connAppendf(c, "ERROR no questions in bank\n");
+            return 1;
+        }
+        c->inExam = 1;
+        serveNextQuestion(c);
+    } else if (strncmp(line, "ANSWER ", 7) == 0) {
+        if (!c->inExam) {
+            connAppendf(c, "ERROR no exam in progress\n");
+            return 1;
+        }
+        char correct = c->session.pending ? c->session.pending->correctAnswer : 0;
+        AnswerResult result = submitAnswer(&c->session, line[7]);
+        if (result == ANSWER_CORRECT) connAppendf(c, "CORRECT\n");
+        else if (result == ANSWER_WRONG) connAppendf(c, "WRONG %c\n", correct);
+        else if (result == ANSWER_TIMED_OUT) connAppendf(c, "TIMEOUT\n");
+        else connAppendf(c, "SKIPPED\n");
+        serveNextQuestion(c);
+    } else if (strncmp(line, "SEARCH ", 7) == 0) {
+        int slots[SEARCH_RESULTS_SHOWN];
+        int matches = searchQuestions(line + 7, slots, SEARCH_RESULTS_SHOWN);
+        if (matches < 0) {
+            connAppendf(c, matches == -2 ? "ERROR search unavailable\n" : "ERROR no keywords\n");
+            return 1;
+        }
+        connAppendf(c, "MATCHES %d", matches);
+        for (int i = 0; i < matches && i < SEARCH_RESULTS_SHOWN; i++) {
+            connAppendf(c, " %lld", questions[slots[i]].id);
+        }
+        connAppend(c, "\n", 1);
+    } else if (strcmp(line, "QUIT") == 0) {
+        return 0;
+    } else {
+        connAppendf(c, "ERROR unknown command\n");
+    }
+    return 1;
+}
+
+// Writes as much pending output as the socket takes; returns -1 on error
+static int flushConnection(int epollFd, ServerConnection* c) {
+    while (c->outSent < c->outLength) {
+        ssize_t n = send(c->fd, c->out + c->outSent, c->outLength - c->outSent, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) return -1;
+            break;
+        }
+        c->outSent += (size_t)n;
+    }
+
+    int blocked = c->outSent < c->outLength;
+    if (!blocked) {
+        c->outSent = 0;
+        c->outLength = 0;
+    }
+    if (blocked != c->wantWrite) {
+        struct epoll_event ev;
+        ev.events = EPOLLIN | (blocked ? EPOLLOUT : 0);
+        ev.data.ptr = c;
+        epoll_ctl(epollFd, EPOLL_CTL_MOD, c->fd, &ev);
+        c->wantWrite = blocked;
+    }
+    return 0;
+}
+
+// Reads everything available and handles each complete line; returns 0
+// when the connection should close
+static int readConnection(ServerConnection* c) {
+    char buffer[4096];
+    for (;;) {
+        ssize_t n = recv(c->fd, buffer, sizeof(buffer), 0);
+        if (n == 0) return 0;
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        for (ssize_t i = 0; i < n; i++) {
+            char ch = buffer[i];
+            if (ch == '\n') {
+                if (c->inLength > 0 && c->in[c->inLength - 1] == '\r') c->inLength--;
+                c->in[c->inLength] = '\0';
+                c->inLength = 0;
+                if (!handleServerLine(c, c->in) || c->overflow) return 0;
+            } else if (c->inLength < SERVER_LINE_MAX - 1) {
+                c->in[c->inLength++] = ch;
+            }
+        }
+    }
+}
+
+static void closeConnection(ServerConnection* c) {
+    if (c->prev != NULL) c->prev->next = c->next;
+    else serverConnections = c->next;
+    if (c->next != NULL) c->next->prev = c->prev;
+    cancelTimer(&serverTimers, &c->deadline);
+    cancelTimer(&serverTimers, &c->idle);
+    // A forked snapshot writer shares the socket, so close() alone would
+    // leave it registered and epoll would keep reporting the freed c
+    epoll_ctl(serverEpollFd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    // Hang-ups, idle timeouts and shutdown still record the exam
+    if (c->inExam) abandonSession(&c->session);
+    freeSession(&c->session);
+    free(c->out);
+    free(c);
+}
+
+// Keeps the deadline timer on the pending question, if it has one
+static void armQuestionTimer(ServerConnection* c) {
+    if (c->inExam && c->session.questionDeadlineNs != 0) {
+        armTimer(&serverTimers, &c->deadline, c->session.questionDeadlineNs);
+    } else {
+        cancelTimer(&serverTimers, &c->deadline);
+    }
+}
+
+// Timer wheel callback: skips an expired question and serves what comes
+// next (another question or the result), or drops an idle connection
+static void serverTimerExpired(void* context, TimerEntry* timer) {
+    int epollFd = *(const int*)context;
+    ServerConnection* c = (ServerConnection*)timer->owner;
+    if (timer == &c->idle) {
+        closeConnection(c);
+        return;
+    }
+    if (c->inExam && expireSession(&c->session, monotonicNs())) {
+        connAppendf(c, "TIMEOUT\n");
+        serveNextQuestion(c);
+    }
+    armQuestionTimer(c);
+    if (c->overflow || flushConnection(epollFd, c) != 0) closeConnection(c);
+}
+
+int runExamServer(int port) {
+    refreshBankIndexes();
+    renderQuestions();
+    buildPathTable();
+    if (searchIndex.version != bankVersion) buildSearchIndex();
+    int listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (listenFd < 0) {
+        perror("socket");
+        return -1;
+    }
+    int one = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons((uint16_t)port);
+    if (bind(listenFd, (struct sockaddr*)&addr, sizeof(addr)) != 0 ||
+        listen(listenFd, SOMAXCONN) != 0) {
+        perror("bind/listen");
+        close(listenFd);
+        return -1;
+    }
+
+    int epollFd = epoll_create1(0);
+    if (epollFd < 0) {
+        perror("epoll_create1");
+        close(listenFd);
+        return -1;
+    }
+    serverEpollFd = epollFd;
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;   // NULL marks the listening socket
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &ev) != 0) {
+        perror("epoll_ctl");
+        close(epollFd);
+        close(listenFd);
+        return -1;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, stopServer);
+    signal(SIGTERM, stopServer);
+    refreshBankIndexes();
+    printf("Exam server listening on port %d with %d questions\n", port, questionCount);
+    fflush(stdout);
+
+    initTimerWheel(&serverTimers, monotonicNs());
+    struct epoll_event events[SERVER_MAX_EVENTS];
+    while (serverRunning) {
+        int64_t waitNs = timerWheelWaitNs(&serverTimers, monotonicNs());
+        int waitMs = waitNs < 0 ? -1 : waitNs / 1000000 >= INT_MAX ? INT_MAX : (int)((waitNs + 999999) / 1000000);
+        int count = epoll_wait(epollFd, events, SERVER_MAX_EVENTS, waitMs);
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait");
+            break;
+        }
+
+        for (int i = 0; i < count; i++) {
+            ServerConnection* c = (ServerConnection*)events[i].data.ptr;
+            if (c == NULL) {
+                int fd;
+                while ((fd = accept(listenFd, NULL, NULL)) >= 0) {
+                    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+                    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                    c = (ServerConnection*)calloc(1, sizeof(ServerConnection));
+                    if (c == NULL) {
+                        close(fd);
+                        continue;
+                    }
+                    c->fd = fd;
+                    c->next = serverConnections;
+                    if (serverConnections != NULL) serverConnections->prev = c;
+                    serverConnections = c;
+                    c->deadline.owner = c;
+                    c->idle.owner = c;
+                    initSession(&c->session);
+                    if (idleTimeoutNs > 0) armTimer(&serverTimers, &c->idle, monotonicNs() + idleTimeoutNs);
+                    ev.events = EPOLLIN;
+                    ev.data.ptr = c;
+                    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+                        perror("epoll_ctl");
+                        closeConnection(c);
+                    }
+                }
+                if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                    perror("accept");
+                }
+                continue;
+            }
+
+            int keep = 1;
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                // Requests that arrived before a hang-up are still answered
+                keep = readConnection(c);
+                if (keep && (events[i].events & (EPOLLHUP | EPOLLERR))) keep = 0;
+                if (keep) {
+                    armQuestionTimer(c);
+                    if (idleTimeoutNs > 0) armTimer(&serverTimers, &c->idle, monotonicNs() + idleTimeoutNs);
+                }
+            }
+            if (keep || c->outLength > c->outSent) {
+                // Flush replies even when the client asked to quit
+                if (flushConnection(epollFd, c) != 0) keep = 0;
+            }
+            if (!keep) closeConnection(c);
+        }
+        // After the events, so none of them refers to a connection a timer closed
+        advanceTimerWheel(&serverTimers, monotonicNs(), serverTimerExpired, &epollFd);
+        maybeWriteSnapshot();
+    }
+
+    while (serverConnections != NULL) closeConnection(serverConnections);
+    printf("\nExam server stopped.\n");
+    close(epollFd);
+    close(listenFd);
+    return 0;
+}
+#else
+int runExamServer(int port) {
+    (void)port;
+    printf("Server mode is only available on Linux.\n");
+    return -1;
+}
+#endif